@@ -7,6 +7,21 @@
 #include <math.h>
 #include <wchar.h>
 #include <locale.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <signal.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+#ifdef USE_ZLIB
+#include <zlib.h>
+#endif
 
 #define STANDARD_DECK_SIZE 52
 #define NUM_HOLE_CARDS_PER_PLAYER 2
@@ -26,6 +41,8 @@
 #define MIN_NUM_PLAYERS 2
 #define MAX_NUM_PLAYERS 22
 
+#define NUM_HOLE_CARDS_COMBINATIONS 1326
+
 // card ranks:
 #define TWO 0
 #define THREE 1
@@ -57,29 +74,82 @@
 #define FULL_HOUSE 6
 #define FOUR_OF_A_KIND 7
 #define STRAIGHT_FLUSH 8
-
-char card_rank_to_human_readable[NUM_CARD_RANKS][3];
-wchar_t suit_to_human_readable[NUM_SUITS];
-Deck original_unshuffled_standard_deck;
+#define NUM_HAND_RANKS 9
 
 typedef struct {
     uint8_t rank;
     uint8_t suit;
 } Card;
 
+// One bit per card, at index suit * 13 + rank, so each suit's ranks form a contiguous 13-bit field
+typedef uint64_t CardMask;
+
+#define FULL_DECK_CARD_MASK ((((CardMask) 1) << STANDARD_DECK_SIZE) - 1)
+#define SUIT_RANK_MASK 0x1FFF
+
+uint8_t get_card_index(Card* card) {
+    return card->suit * NUM_CARD_RANKS + card->rank;
+}
+
+CardMask get_card_mask(Card* card) {
+    return ((CardMask) 1) << get_card_index(card);
+}
+
+Card get_card_from_index(uint8_t index) {
+    Card res;
+    res.rank = index % NUM_CARD_RANKS;
+    res.suit = index / NUM_CARD_RANKS;
+    return res;
+}
+
+uint16_t get_suit_rank_mask(CardMask cards, uint8_t suit) {
+    return (cards >> (suit * NUM_CARD_RANKS)) & SUIT_RANK_MASK;
+}
+
+uint8_t get_card_mask_count(CardMask cards) {
+    return __builtin_popcountll(cards);
+}
+
+// Writes the cards of the mask into the array, lowest index first, and returns how many there are
+uint8_t get_cards_from_card_mask(CardMask cards, Card* destination_cards) {
+    uint8_t count = 0;
+    while (cards != 0) {
+        destination_cards[count++] = get_card_from_index(__builtin_ctzll(cards));
+        cards &= cards - 1;
+    }
+    return count;
+}
+
 typedef struct {
     Card cards[NUM_HOLE_CARDS_PER_PLAYER];
     uint8_t count;
+    CardMask mask;
 } HoleCards;
 
 HoleCards init_hole_cards() {
     HoleCards res;
     res.count = 0;
+    res.mask = 0;
     return res;
 }
 
+// Weights of the hole cards combinations a player can have (see hole_cards_combinations)
+typedef struct {
+    double weights[NUM_HOLE_CARDS_COMBINATIONS];
+    // alias table over the combinations that don't use known cards, set up by init_range_sampler
+    uint16_t num_live_combinations;
+    uint16_t live_combinations[NUM_HOLE_CARDS_COMBINATIONS];
+    uint32_t alias_thresholds[NUM_HOLE_CARDS_COMBINATIONS];
+    uint16_t aliases[NUM_HOLE_CARDS_COMBINATIONS];
+    // equity and number of trials of each combination in the last simulation
+    double combination_equities[NUM_HOLE_CARDS_COMBINATIONS];
+    uint64_t combination_num_trials[NUM_HOLE_CARDS_COMBINATIONS];
+} Range;
+
 typedef struct {
     HoleCards hole_cards[MAX_NUM_PLAYERS];
+    // players whose hole cards are unknown get them from their range if they have one, or else from all the unseen cards
+    Range* ranges[MAX_NUM_PLAYERS];
     uint8_t count;
 } Players;
 
@@ -87,6 +157,7 @@ Players init_players(uint8_t* count) {
     Players res;
     for (res.count = 0; res.count < *count; ++(res.count)) {
         res.hole_cards[res.count] = init_hole_cards();
+        res.ranges[res.count] = NULL;
     }
     return res;
 }
@@ -94,11 +165,13 @@ Players init_players(uint8_t* count) {
 typedef struct {
     Card cards[MAX_NUM_COMMUNITY_CARDS];
     uint8_t count;
+    CardMask mask;
 } CommunityCards;
 
 CommunityCards init_community_cards() {
     CommunityCards res;
     res.count = 0;
+    res.mask = 0;
     return res;
 }
 
@@ -116,22 +189,31 @@ Hand init_hand() {
 typedef struct {
     Card cards[STANDARD_DECK_SIZE];
     uint8_t count;
+    CardMask mask;
 } Deck;
 
 Deck init_deck() {
     Deck res;
     res.count = 0;
+    res.mask = 0;
     return res;
 }
 
+char card_rank_to_human_readable[NUM_CARD_RANKS][3];
+const char* hand_rank_names[NUM_HAND_RANKS] = { "nothing", "pair", "two pairs", "three of a kind", "straight", "flush", "full house", "four of a kind", "straight flush" };
+wchar_t suit_to_human_readable[NUM_SUITS];
+Deck original_unshuffled_standard_deck;
+
 typedef struct {
     Card cards[MAX_NUM_BURNED_CARDS];
     uint8_t count;
+    CardMask mask;
 } BurnedCards;
 
 BurnedCards init_burned_cards() {
     BurnedCards res;
     res.count = 0;
+    res.mask = 0;
     return res;
 }
 
@@ -167,15 +249,19 @@ SequencesOfCardsOfEqualRank init_sequences_of_cards_of_equal_rank() {
     return res;
 }
 
-Deck get_unseen_cards_from_perspective_of_tv_watcher(Deck* deck, BurnedCards* burned_cards) {
-    Deck res = init_deck();
-    uint8_t i;
-    for (i = 0; i < deck->count; ++i) {
-        res.cards[(res.count)++] = deck->cards[i];
-    }
-    for (i = 0; i < burned_cards->count; ++i) {
-        res.cards[(res.count)++] = burned_cards->cards[i];
+// The tv watcher sees every player's hole cards and the community cards; the deck and the burned cards are unseen
+CardMask get_unseen_cards_from_perspective_of_tv_watcher(Players* players, CommunityCards* community_cards) {
+    CardMask seen_cards = community_cards->mask;
+    for (uint8_t i = 0; i < players->count; ++i) {
+        seen_cards |= players->hole_cards[i].mask;
     }
+    return FULL_DECK_CARD_MASK & ~seen_cards;
+}
+
+Deck get_deck_from_card_mask(CardMask cards) {
+    Deck res = init_deck();
+    res.count = get_cards_from_card_mask(cards, res.cards);
+    res.mask = cards;
     return res;
 }
 
@@ -184,6 +270,9 @@ void print_card(Card* card) {
 }
 
 void print_cards(Card* cards, uint8_t* count) {
+    if (*count == 0) {
+        return;
+    }
     uint8_t i;
     for (i = 0; i < *count - 1; ++i) {
         print_card(&cards[i]);
@@ -197,7 +286,7 @@ void display_table_for_tv_watcher(Players* players, CommunityCards* community_ca
     for (i = 0; i < players->count; ++i) {
         printf("Player %d: ", i);
         print_cards(players->hole_cards[i].cards, &players->hole_cards[i].count);
-        printf(" (%.0Lf%%)\n", players_equities[i] * 100);
+        printf(" (%.0f%%)\n", players_equities[i] * 100);
     }
     for (i = 0; i < 7; ++i) {
         printf("\t");
@@ -239,35 +328,142 @@ void init_suit_to_human_readable() {
     suit_to_human_readable[SPADES] = L'♠';
 }
 
-void init_rand() {
-    srand(time(NULL));
+// #############################################
+// Random number generators
+// #############################################
+
+// random number generators:
+#define XOSHIRO256_STAR_STAR 0
+#define PCG32 1
+#define RAND_R 2
+// counter-based: its n-th number is a hash of the seed plus n increments, so it can move to any position at once
+#define SPLITMIX64 3
+
+#define SPLITMIX64_INCREMENT 0x9E3779B97F4A7C15
+// Streams of SplitMix64 generators seeded alike are this many numbers apart
+#define SPLITMIX64_STREAM_SHIFT 48
+
+typedef struct {
+    uint64_t state[4];
+    uint8_t algorithm;
+} RandomNumberGenerator;
+
+uint8_t random_number_generator_algorithm = XOSHIRO256_STAR_STAR;
+
+// Generator of the main thread; simulation workers seed their own generators from it
+RandomNumberGenerator main_random_number_generator;
+// for simulations started from several threads
+pthread_mutex_t main_random_number_generator_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// --seed makes runs reproducible: the main generator starts from it, and simulations deal every trial from its own
+// part of a SplitMix64 sequence, so that their results don't depend on the threads or shards that run the trials
+bool is_seeded = false;
+uint64_t seed_option = 0;
+
+uint64_t splitmix64(uint64_t* state) {
+    uint64_t z = (*state += SPLITMIX64_INCREMENT);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+    return z ^ (z >> 31);
 }
 
-void init_original_unshuffled_standard_deck() {
-    original_unshuffled_standard_deck = get_unshuffled_standard_deck();
+uint64_t rotate_left(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
 }
 
-void init_globals() {
-    init_card_rank_to_human_readable();
-    init_suit_to_human_readable();
-    init_original_unshuffled_standard_deck();
+uint64_t get_xoshiro256_star_star_random_number(uint64_t* state) {
+    uint64_t res = rotate_left(state[1] * 5, 7) * 9;
+    uint64_t t = state[1] << 17;
+    state[2] ^= state[0];
+    state[3] ^= state[1];
+    state[1] ^= state[2];
+    state[0] ^= state[3];
+    state[2] ^= t;
+    state[3] = rotate_left(state[3], 45);
+    return res;
 }
 
-void init() {
-    init_rand();
-    init_globals();
+// Advances the state by 2^128 numbers, so that generators jumped a different number of times never overlap
+void jump_xoshiro256_star_star(uint64_t* state) {
+    static const uint64_t jump[] = { 0x180EC6D33CFD0ABA, 0xD5A61266F0C9392C, 0xA9582618E03FC9AA, 0x39ABDC4529B1661C };
+    uint64_t jumped_state[4] = { 0 };
+    for (uint8_t i = 0; i < 4; ++i) {
+        for (uint8_t bit = 0; bit < 64; ++bit) {
+            if (jump[i] & (((uint64_t) 1) << bit)) {
+                for (uint8_t j = 0; j < 4; ++j) {
+                    jumped_state[j] ^= state[j];
+                }
+            }
+            get_xoshiro256_star_star_random_number(state);
+        }
+    }
+    memcpy(state, jumped_state, sizeof(jumped_state));
 }
 
-uint8_t get_rand_index(uint8_t* length) {
-    return rand() % *length;
+uint32_t get_pcg32_random_number(uint64_t* state) {
+    uint64_t old_state = state[0];
+    state[0] = old_state * 6364136223846793005 + state[1];
+    uint32_t xor_shifted = ((old_state >> 18) ^ old_state) >> 27;
+    uint32_t rotation = old_state >> 59;
+    return (xor_shifted >> rotation) | (xor_shifted << ((-rotation) & 31));
 }
 
-void pop_and_append_card(Card* source_cards, uint8_t* source_cards_count, uint8_t pop_index, Card* destination_cards, uint8_t* destination_cards_count) {
-    destination_cards[(*destination_cards_count)++] = source_cards[pop_index];
-    --(*source_cards_count);
-    for (uint8_t i = pop_index; i < *source_cards_count; ++i) {
-        source_cards[i] = source_cards[i + 1];
+// Generators seeded with the same seed but different streams produce independent sequences
+RandomNumberGenerator init_random_number_generator(uint8_t algorithm, uint64_t seed, uint16_t stream) {
+    RandomNumberGenerator res;
+    res.algorithm = algorithm;
+    uint64_t splitmix64_state = seed;
+    if (algorithm == XOSHIRO256_STAR_STAR) {
+        for (uint8_t i = 0; i < 4; ++i) {
+            res.state[i] = splitmix64(&splitmix64_state);
+        }
+        for (uint16_t i = 0; i < stream; ++i) {
+            jump_xoshiro256_star_star(res.state);
+        }
+    }
+    else if (algorithm == PCG32) {
+        res.state[0] = 0;
+        res.state[1] = (((uint64_t) stream) << 1) | 1;
+        get_pcg32_random_number(res.state);
+        res.state[0] += splitmix64(&splitmix64_state);
+        get_pcg32_random_number(res.state);
+    }
+    else if (algorithm == SPLITMIX64) {
+        res.state[0] = seed + (((uint64_t) stream) << SPLITMIX64_STREAM_SHIFT) * SPLITMIX64_INCREMENT;
+    }
+    else {
+        res.state[0] = (unsigned int) (splitmix64(&splitmix64_state) + stream);
+    }
+    return res;
+}
+
+// Moves a SplitMix64 generator to the given number of its seed's sequence
+void seek_splitmix64(RandomNumberGenerator* random_number_generator, uint64_t seed, uint64_t position) {
+    random_number_generator->state[0] = seed + position * SPLITMIX64_INCREMENT;
+}
+
+uint32_t get_random_number(RandomNumberGenerator* random_number_generator) {
+    if (random_number_generator->algorithm == XOSHIRO256_STAR_STAR) {
+        return get_xoshiro256_star_star_random_number(random_number_generator->state) >> 32;
+    }
+    if (random_number_generator->algorithm == PCG32) {
+        return get_pcg32_random_number(random_number_generator->state);
     }
+    if (random_number_generator->algorithm == SPLITMIX64) {
+        return splitmix64(&random_number_generator->state[0]) >> 32;
+    }
+    unsigned int rand_r_state = random_number_generator->state[0];
+    uint32_t res = rand_r(&rand_r_state);
+    random_number_generator->state[0] = rand_r_state;
+    return res;
+}
+
+uint64_t get_random_seed(RandomNumberGenerator* random_number_generator) {
+    return ((uint64_t) get_random_number(random_number_generator) << 32) | get_random_number(random_number_generator);
+}
+
+void init_rand() {
+    main_random_number_generator = init_random_number_generator(random_number_generator_algorithm, is_seeded == true ? seed_option : (uint64_t) time(NULL), 0);
 }
 
 Deck get_unshuffled_standard_deck() {
@@ -279,20 +475,126 @@ Deck get_unshuffled_standard_deck() {
             ++(res.count);
         }
     }
+    res.mask = FULL_DECK_CARD_MASK;
     return res;
 }
 
-Deck get_shuffled_deck(Deck* original_unshuffled_deck) {
+void init_original_unshuffled_standard_deck() {
+    original_unshuffled_standard_deck = get_unshuffled_standard_deck();
+}
+
+// Uniform in [0, length), by Lemire's multiply-and-reject method; RAND_R keeps the old (biased) modulo for comparison
+uint8_t get_rand_index(uint8_t* length, RandomNumberGenerator* random_number_generator) {
+    if (random_number_generator->algorithm == RAND_R) {
+        return get_random_number(random_number_generator) % *length;
+    }
+    uint64_t product = (uint64_t) get_random_number(random_number_generator) * *length;
+    if ((uint32_t) product < *length) {
+        uint32_t threshold = (uint32_t) -*length % *length;
+        while ((uint32_t) product < threshold) {
+            product = (uint64_t) get_random_number(random_number_generator) * *length;
+        }
+    }
+    return product >> 32;
+}
+
+void pop_and_append_card(Card* source_cards, uint8_t* source_cards_count, CardMask* source_cards_mask, uint8_t pop_index, Card* destination_cards, uint8_t* destination_cards_count, CardMask* destination_cards_mask) {
+    CardMask card_mask = get_card_mask(&source_cards[pop_index]);
+    *source_cards_mask &= ~card_mask;
+    *destination_cards_mask |= card_mask;
+    destination_cards[(*destination_cards_count)++] = source_cards[pop_index];
+    --(*source_cards_count);
+    for (uint8_t i = pop_index; i < *source_cards_count; ++i) {
+        source_cards[i] = source_cards[i + 1];
+    }
+}
+
+Deck get_shuffled_deck(Deck* original_unshuffled_deck, RandomNumberGenerator* random_number_generator) {
     Deck res = init_deck();
     Deck original_unshuffled_deck_copy = *original_unshuffled_deck;
     while (original_unshuffled_deck_copy.count > 0) {
-        pop_and_append_card(original_unshuffled_deck_copy.cards, &original_unshuffled_deck_copy.count, get_rand_index(&original_unshuffled_deck_copy.count), res.cards, &res.count);
+        pop_and_append_card(original_unshuffled_deck_copy.cards, &original_unshuffled_deck_copy.count, &original_unshuffled_deck_copy.mask, get_rand_index(&original_unshuffled_deck_copy.count, random_number_generator), res.cards, &res.count, &res.mask);
+    }
+    return res;
+}
+
+// Partial Fisher-Yates shuffle: moves num_cards uniformly drawn cards to the front of the deck and returns them.
+// The deck stays a permutation of the same cards, so it can be drawn from again without being reset.
+CardMask draw_random_cards(Deck* deck, uint8_t num_cards, RandomNumberGenerator* random_number_generator) {
+    CardMask res = 0;
+    for (uint8_t i = 0; i < num_cards; ++i) {
+        uint8_t num_remaining_cards = deck->count - i;
+        uint8_t j = i + get_rand_index(&num_remaining_cards, random_number_generator);
+        Card card = deck->cards[j];
+        deck->cards[j] = deck->cards[i];
+        deck->cards[i] = card;
+        res |= get_card_mask(&card);
+    }
+    return res;
+}
+
+// Like draw_random_cards, but skips the excluded cards (moving them to the back of the deck)
+CardMask draw_random_cards_excluding(Deck* deck, uint8_t num_cards, CardMask excluded_cards, RandomNumberGenerator* random_number_generator) {
+    CardMask res = 0;
+    uint8_t num_candidate_cards = deck->count;
+    uint8_t i = 0;
+    while (i < num_cards) {
+        uint8_t num_remaining_cards = num_candidate_cards - i;
+        uint8_t j = i + get_rand_index(&num_remaining_cards, random_number_generator);
+        Card card = deck->cards[j];
+        if ((get_card_mask(&card) & excluded_cards) != 0) {
+            --num_candidate_cards;
+            deck->cards[j] = deck->cards[num_candidate_cards];
+            deck->cards[num_candidate_cards] = card;
+            continue;
+        }
+        deck->cards[j] = deck->cards[i];
+        deck->cards[i] = card;
+        res |= get_card_mask(&card);
+        ++i;
+    }
+    return res;
+}
+
+// Same as draw_random_cards, on a deck of card indices (suit * 13 + rank)
+CardMask draw_random_card_indices(uint8_t* card_indices, uint8_t num_card_indices, uint8_t num_cards, RandomNumberGenerator* random_number_generator) {
+    CardMask res = 0;
+    for (uint8_t i = 0; i < num_cards; ++i) {
+        uint8_t num_remaining_cards = num_card_indices - i;
+        uint8_t j = i + get_rand_index(&num_remaining_cards, random_number_generator);
+        uint8_t card_index = card_indices[j];
+        card_indices[j] = card_indices[i];
+        card_indices[i] = card_index;
+        res |= (CardMask) 1 << card_index;
     }
     return res;
 }
 
-void deal_card(Deck* deck, Card* destination_cards, uint8_t* destination_cards_count) {
-    pop_and_append_card(deck->cards, &deck->count, deck->count - 1, destination_cards, destination_cards_count);
+// Same as draw_random_cards_excluding, on a deck of card indices
+CardMask draw_random_card_indices_excluding(uint8_t* card_indices, uint8_t num_card_indices, uint8_t num_cards, CardMask excluded_cards, RandomNumberGenerator* random_number_generator) {
+    CardMask res = 0;
+    uint8_t num_candidate_cards = num_card_indices;
+    uint8_t i = 0;
+    while (i < num_cards) {
+        uint8_t num_remaining_cards = num_candidate_cards - i;
+        uint8_t j = i + get_rand_index(&num_remaining_cards, random_number_generator);
+        uint8_t card_index = card_indices[j];
+        if ((((CardMask) 1 << card_index) & excluded_cards) != 0) {
+            --num_candidate_cards;
+            card_indices[j] = card_indices[num_candidate_cards];
+            card_indices[num_candidate_cards] = card_index;
+            continue;
+        }
+        card_indices[j] = card_indices[i];
+        card_indices[i] = card_index;
+        res |= (CardMask) 1 << card_index;
+        ++i;
+    }
+    return res;
+}
+
+void deal_card(Deck* deck, Card* destination_cards, uint8_t* destination_cards_count, CardMask* destination_cards_mask) {
+    pop_and_append_card(deck->cards, &deck->count, &deck->mask, deck->count - 1, destination_cards, destination_cards_count, destination_cards_mask);
 }
 
 int compare_cards(const void* card_0, const void* card_1) {
@@ -479,17 +781,17 @@ uint32_t hand_strength(Card* sorted_hand) {
 void deal_hole_cards(Players* players, Deck* deck) {
     for (uint8_t i = 0; i < NUM_HOLE_CARDS_PER_PLAYER; ++i) {
         for (uint8_t j = 0; j < players->count; ++j) {
-            deal_card(deck, players->hole_cards[j].cards, &players->hole_cards[j].count);
+            deal_card(deck, players->hole_cards[j].cards, &players->hole_cards[j].count, &players->hole_cards[j].mask);
         }
     }
 }
 
 void burn_card(Deck* deck, BurnedCards* burned_cards) {
-    deal_card(deck, burned_cards->cards, &burned_cards->count);
+    deal_card(deck, burned_cards->cards, &burned_cards->count, &burned_cards->mask);
 }
 
 void deal_community_card(CommunityCards* community_cards, Deck* deck) {
-    deal_card(deck, community_cards->cards, &community_cards->count);
+    deal_card(deck, community_cards->cards, &community_cards->count, &community_cards->mask);
 }
 
 void deal_the_flop(CommunityCards* community_cards, Deck* deck, BurnedCards* burned_cards) {
@@ -509,21 +811,15 @@ void deal_the_river(CommunityCards* community_cards, Deck* deck, BurnedCards* bu
     deal_community_card(community_cards, deck);
 }
 
-uint32_t get_player_strongest_hand(Card* hole_cards, Card* community_cards) {
+uint32_t get_player_strongest_hand_by_brute_force(CardMask hole_cards, CardMask community_cards) {
     
     Card available_cards[MAX_NUM_COMMUNITY_CARDS + NUM_HOLE_CARDS_PER_PLAYER];
-
-    uint8_t i;
-    for (i = 0; i < MAX_NUM_COMMUNITY_CARDS; ++i) {
-        available_cards[i] = community_cards[i];
-    }
-    for (i = 0; i < NUM_HOLE_CARDS_PER_PLAYER; ++i) {
-        available_cards[MAX_NUM_COMMUNITY_CARDS + i] = hole_cards[i];
-    }
+    get_cards_from_card_mask(hole_cards | community_cards, available_cards);
 
     uint32_t res = 0;
 
-    Card possible_hand[5];
+    Hand possible_hand = init_hand();
+    possible_hand.count = HAND_LENGTH;
     uint32_t possible_strength;
 
     for (uint8_t i = 0; i < 3; ++i) {
@@ -532,15 +828,15 @@ uint32_t get_player_strongest_hand(Card* hole_cards, Card* community_cards) {
                 for (uint8_t l = k + 1; l < 6; ++l) {
                     for (uint8_t m = l + 1; m < 7; ++m) {
 
-                        possible_hand[0] = available_cards[i];
-                        possible_hand[1] = available_cards[j];
-                        possible_hand[2] = available_cards[k];
-                        possible_hand[3] = available_cards[l];
-                        possible_hand[4] = available_cards[m];
+                        possible_hand.cards[0] = available_cards[i];
+                        possible_hand.cards[1] = available_cards[j];
+                        possible_hand.cards[2] = available_cards[k];
+                        possible_hand.cards[3] = available_cards[l];
+                        possible_hand.cards[4] = available_cards[m];
 
-                        sort_hand(possible_hand);
+                        sort_hand(&possible_hand);
 
-                        possible_strength = hand_strength(possible_hand);
+                        possible_strength = hand_strength(possible_hand.cards);
 
                         if (possible_strength > res) {
                             res = possible_strength;
@@ -554,157 +850,6180 @@ uint32_t get_player_strongest_hand(Card* hole_cards, Card* community_cards) {
     return res;
 }
 
-void set_players_equities(double* players_equities, Players* players, Card* community_cards) {
-    uint8_t num_winning_players = 1;
-    double equity_for_each_winner = (double) 1 / num_winning_players;
-    players_equities[0] = equity_for_each_winner;
-    uint32_t strongest_hand = get_player_strongest_hand(players->hole_cards[0].cards, community_cards);
-    for (uint8_t i = 1; i < players->count; ++i) {
-        players_equities[i] = 0;
+// #############################################
+// Lookup-table hand evaluator
+// #############################################
+
+// Scores are identical to the ones hand_strength produces:
+// hand rank * 13^5 + kicker 1 * 13^4 + ... + kicker 5 * 13^0
+
+#define NUM_RANK_MASKS (1 << NUM_CARD_RANKS)
+
+#define HAND_RANK_WEIGHT 371293
+#define KICKER_1_WEIGHT 28561
+#define KICKER_2_WEIGHT 2197
+#define KICKER_3_WEIGHT 169
+#define KICKER_4_WEIGHT 13
+#define KICKER_5_WEIGHT 1
+
+// hand evaluators:
+#define BRUTE_FORCE_EVALUATOR 0
+#define LOOKUP_TABLE_EVALUATOR 1
+
+uint8_t hand_evaluator = LOOKUP_TABLE_EVALUATOR;
+
+// highest rank in a rank mask (0 for the empty mask)
+uint8_t highest_rank_table[NUM_RANK_MASKS];
+// score of the n highest ranks in a rank mask, as n kickers of decreasing weight
+uint32_t kickers_score_table[HAND_LENGTH + 1][NUM_RANK_MASKS];
+// score of the best straight in a rank mask (0 if there is none)
+uint32_t straight_score_table[NUM_RANK_MASKS];
+// score of the best flush or straight flush in a single suit's rank mask (0 if there is none)
+uint32_t flush_score_table[NUM_RANK_MASKS];
+
+// Returns the kicker of the highest straight in the rank mask, or -1 if there is none
+int8_t get_straight_kicker_rank(uint16_t rank_mask) {
+    for (int8_t rank = MAX_CARD_RANK; rank >= SIX; --rank) {
+        uint16_t straight_mask = 0x1F << (rank - 4);
+        if ((rank_mask & straight_mask) == straight_mask) {
+            return rank;
+        }
     }
-    uint32_t cur_player_strongest_hand_strength;
-    for (uint8_t i = 1; i < players->count; ++i) {
-        cur_player_strongest_hand_strength = get_player_strongest_hand(players->hole_cards[i].cards, community_cards);
-        if (cur_player_strongest_hand_strength > strongest_hand) {
-            strongest_hand = cur_player_strongest_hand_strength;
-            num_winning_players = 1;
-            equity_for_each_winner = (double) 1 / num_winning_players;
-            players_equities[i] = equity_for_each_winner;
-            for (uint8_t j = 0; j < i; ++j) {
-                players_equities[j] = 0;
+    uint16_t wheel_mask = (1 << ACE) | (1 << TWO) | (1 << THREE) | (1 << FOUR) | (1 << FIVE);
+    if ((rank_mask & wheel_mask) == wheel_mask) {
+        return FIVE;
+    }
+    return -1;
+}
+
+void init_hand_evaluator_tables() {
+    for (uint32_t rank_mask = 0; rank_mask < NUM_RANK_MASKS; ++rank_mask) {
+        highest_rank_table[rank_mask] = 0;
+        for (int8_t rank = MAX_CARD_RANK; rank >= MIN_CARD_RANK; --rank) {
+            if (rank_mask & (1 << rank)) {
+                highest_rank_table[rank_mask] = rank;
+                break;
             }
         }
-        else if (cur_player_strongest_hand_strength == strongest_hand) {
-            ++num_winning_players;
-            equity_for_each_winner = (double) 1 / num_winning_players;
-            players_equities[i] = equity_for_each_winner;
-            for (uint8_t j = 0; j < i; ++j) {
-                if (players_equities[j] > 0) {
-                    players_equities[j] = equity_for_each_winner;
+
+        for (uint8_t num_kickers = 0; num_kickers <= HAND_LENGTH; ++num_kickers) {
+            uint32_t score = 0;
+            uint8_t num_kickers_found = 0;
+            for (int8_t rank = MAX_CARD_RANK; rank >= MIN_CARD_RANK && num_kickers_found < num_kickers; --rank) {
+                if (rank_mask & (1 << rank)) {
+                    score = score * NUM_CARD_RANKS + rank;
+                    ++num_kickers_found;
                 }
             }
+            for (; num_kickers_found < num_kickers; ++num_kickers_found) {
+                score *= NUM_CARD_RANKS;
+            }
+            kickers_score_table[num_kickers][rank_mask] = score;
+        }
+
+        int8_t straight_kicker_rank = get_straight_kicker_rank(rank_mask);
+        if (straight_kicker_rank >= 0) {
+            straight_score_table[rank_mask] = STRAIGHT * HAND_RANK_WEIGHT + straight_kicker_rank * KICKER_1_WEIGHT;
+        }
+        else {
+            straight_score_table[rank_mask] = 0;
+        }
+
+        if (__builtin_popcount(rank_mask) < HAND_LENGTH) {
+            flush_score_table[rank_mask] = 0;
+        }
+        else if (straight_kicker_rank >= 0) {
+            flush_score_table[rank_mask] = STRAIGHT_FLUSH * HAND_RANK_WEIGHT + straight_kicker_rank * KICKER_1_WEIGHT;
+        }
+        else {
+            flush_score_table[rank_mask] = FLUSH * HAND_RANK_WEIGHT + kickers_score_table[HAND_LENGTH][rank_mask];
+        }
+    }
+}
+
+// Scores the best 5-card hand without a flush out of 5 to 7 cards, given the ranks held at least once, twice, three times and four times
+uint32_t evaluate_rank_count_masks(uint16_t singles, uint16_t pairs, uint16_t trips, uint16_t quads) {
+    if (quads != 0) {
+        uint8_t quads_rank = highest_rank_table[quads];
+        return FOUR_OF_A_KIND * HAND_RANK_WEIGHT + quads_rank * KICKER_1_WEIGHT + kickers_score_table[1][singles & ~(1 << quads_rank)] * KICKER_2_WEIGHT;
+    }
+
+    uint8_t trips_rank = highest_rank_table[trips];
+    if (trips != 0) {
+        uint16_t full_house_pairs = pairs & ~(1 << trips_rank);
+        if (full_house_pairs != 0) {
+            return FULL_HOUSE * HAND_RANK_WEIGHT + trips_rank * KICKER_1_WEIGHT + highest_rank_table[full_house_pairs] * KICKER_2_WEIGHT;
+        }
+    }
+
+    if (straight_score_table[singles] != 0) {
+        return straight_score_table[singles];
+    }
+
+    if (trips != 0) {
+        return THREE_OF_A_KIND * HAND_RANK_WEIGHT + trips_rank * KICKER_1_WEIGHT + kickers_score_table[2][singles & ~(1 << trips_rank)] * KICKER_3_WEIGHT;
+    }
+
+    if (pairs != 0) {
+        uint8_t high_pair_rank = highest_rank_table[pairs];
+        uint16_t remaining_pairs = pairs & ~(1 << high_pair_rank);
+        if (remaining_pairs != 0) {
+            uint8_t low_pair_rank = highest_rank_table[remaining_pairs];
+            return TWO_PAIRS * HAND_RANK_WEIGHT + high_pair_rank * KICKER_1_WEIGHT + low_pair_rank * KICKER_2_WEIGHT + kickers_score_table[1][singles & ~(1 << high_pair_rank) & ~(1 << low_pair_rank)] * KICKER_3_WEIGHT;
         }
+        return PAIR * HAND_RANK_WEIGHT + high_pair_rank * KICKER_1_WEIGHT + kickers_score_table[3][singles & ~(1 << high_pair_rank)] * KICKER_4_WEIGHT;
     }
+
+    return NOTHING * HAND_RANK_WEIGHT + kickers_score_table[HAND_LENGTH][singles];
 }
 
+// Scores the best 5-card hand out of 5 to 7 cards given as one rank mask per suit
+uint32_t evaluate_suit_rank_masks(uint16_t* suit_rank_masks) {
+    // At most one suit can hold 5 of 7 cards, and a flush rules out quads and full houses
+    for (uint8_t suit = MIN_SUIT; suit <= MAX_SUIT; ++suit) {
+        if (flush_score_table[suit_rank_masks[suit]] != 0) {
+            return flush_score_table[suit_rank_masks[suit]];
+        }
+    }
+
+    uint16_t clubs = suit_rank_masks[CLUBS];
+    uint16_t diamonds = suit_rank_masks[DIAMONDS];
+    uint16_t hearts = suit_rank_masks[HEARTS];
+    uint16_t spades = suit_rank_masks[SPADES];
 
+    // ranks held at least once, twice, three times and four times
+    uint16_t singles = clubs | diamonds | hearts | spades;
+    uint16_t pairs = (clubs & diamonds) | (hearts & spades) | ((clubs ^ diamonds) & (hearts ^ spades));
+    uint16_t trips = (clubs & diamonds & (hearts | spades)) | (hearts & spades & (clubs | diamonds));
+    uint16_t quads = clubs & diamonds & hearts & spades;
 
+    return evaluate_rank_count_masks(singles, pairs, trips, quads);
+}
 
+uint32_t evaluate_card_mask(CardMask cards) {
+    uint16_t suit_rank_masks[NUM_SUITS];
+    for (uint8_t suit = MIN_SUIT; suit <= MAX_SUIT; ++suit) {
+        suit_rank_masks[suit] = get_suit_rank_mask(cards, suit);
+    }
+    return evaluate_suit_rank_masks(suit_rank_masks);
+}
 
+uint32_t get_player_strongest_hand_from_lookup_tables(CardMask hole_cards, CardMask community_cards) {
+    return evaluate_card_mask(hole_cards | community_cards);
+}
 
+uint32_t get_player_strongest_hand(CardMask hole_cards, CardMask community_cards) {
+    if (hand_evaluator == BRUTE_FORCE_EVALUATOR) {
+        return get_player_strongest_hand_by_brute_force(hole_cards, community_cards);
+    }
+    return get_player_strongest_hand_from_lookup_tables(hole_cards, community_cards);
+}
 
 // #############################################
-// Simulations
+// Shared-board hand evaluator
 // #############################################
 
-#define DEPTH 1e5
-#define NUM_GAMES 1e0
+// All the players share the community cards, so they are worked out once per showdown and each player only adds
+// their two hole cards. Outside of flushes, a 7-card hand's score only depends on how many cards of each rank it
+// holds: with one key per rank whose sums over any 7 ranks are all different, the board's key sum plus the keys of
+// the two hole cards' ranks identifies the hand, and a perfect hash of that sum gives its score.
 
+// sums of 7 of these keys (at most 4 of each) are all different
+uint32_t rank_keys[NUM_CARD_RANKS] = {0, 1, 5, 22, 98, 453, 2031, 8698, 22854, 83661, 262349, 636345, 1479181};
 
-void set_winning_probability_distribution(Game* game, double winning_probability_distribution[MAX_NUM_PLAYERS]) {
-    double wins_distribution[MAX_NUM_PLAYERS];
-    for (uint8_t i = 0; i < game->players.count; ++i) {
-        wins_distribution[i] = 0;
-    }
-    uint64_t iters;
-    for (iters = 0; iters < DEPTH; ++iters) {
+#define MAX_RANK_KEY_SUM (4 * 1479181 + 3 * 636345)
+#define NUM_SEVEN_CARD_RANK_MULTISETS 49205
+// a key sum's row (high bits) gets an offset in the score table, to which its column (low bits) is added
+#define RANK_KEY_SUM_ROW_SHIFT 9
+#define RANK_KEY_SUM_COLUMN_MASK ((1 << RANK_KEY_SUM_ROW_SHIFT) - 1)
+#define NUM_RANK_KEY_SUM_ROWS ((MAX_RANK_KEY_SUM >> RANK_KEY_SUM_ROW_SHIFT) + 1)
+
+uint32_t rank_key_sum_row_offsets[NUM_RANK_KEY_SUM_ROWS];
+// score of the best hand without a flush, by perfect hash of the rank key sum
+uint32_t* rank_key_sum_score_table;
+uint32_t rank_key_sum_score_table_size;
+
+typedef struct {
+    uint32_t rank_key_sum;
+    uint32_t score;
+} RankMultiset;
+
+typedef struct {
+    uint8_t num_cards;
+    uint32_t rank_key_sum;
+    // ranks held at least once, twice, three times and four times, for boards with fewer than 5 cards
+    uint16_t singles;
+    uint16_t pairs;
+    uint16_t trips;
+    uint16_t quads;
+    // the only suit that can make a flush with two more cards (NUM_SUITS if none), and its ranks on the board
+    uint8_t flush_suit;
+    uint16_t flush_suit_rank_mask;
+} BoardState;
+
+uint8_t card_index_to_suit[STANDARD_DECK_SIZE];
+uint16_t card_index_to_rank_bit[STANDARD_DECK_SIZE];
+uint32_t card_index_to_rank_key[STANDARD_DECK_SIZE];
 
-        
-        Deck unseen_cards = get_unseen_cards_from_perspective_of_tv_watcher(&game->deck, &game->burned_cards);
+void add_rank_to_rank_count_masks(uint16_t rank_bit, uint16_t* singles, uint16_t* pairs, uint16_t* trips, uint16_t* quads) {
+    *quads |= *trips & rank_bit;
+    *trips |= *pairs & rank_bit;
+    *pairs |= *singles & rank_bit;
+    *singles |= rank_bit;
+}
 
-        Deck possible_deck = get_shuffled_deck(&unseen_cards);
-        BurnedCards possible_burned_cards = init_burned_cards();
-        for (uint8_t i = 0; i < game->burned_cards.count; ++i) {
-            burn_card(&possible_deck, &possible_burned_cards);
+void enumerate_seven_card_rank_multisets(RankMultiset* rank_multisets, uint32_t* num_rank_multisets, uint8_t rank, uint8_t num_cards, uint32_t rank_key_sum, uint16_t* rank_count_masks) {
+    if (rank == NUM_CARD_RANKS) {
+        if (num_cards == HAND_LENGTH + NUM_HOLE_CARDS_PER_PLAYER) {
+            rank_multisets[*num_rank_multisets].rank_key_sum = rank_key_sum;
+            rank_multisets[*num_rank_multisets].score = evaluate_rank_count_masks(rank_count_masks[0], rank_count_masks[1], rank_count_masks[2], rank_count_masks[3]);
+            ++(*num_rank_multisets);
         }
-        CommunityCards community_cards_copy = game->community_cards;
+        return;
+    }
+    uint16_t masks[4];
+    memcpy(masks, rank_count_masks, sizeof(masks));
+    for (uint8_t count = 0; count <= NUM_SUITS && num_cards + count <= HAND_LENGTH + NUM_HOLE_CARDS_PER_PLAYER; ++count) {
+        enumerate_seven_card_rank_multisets(rank_multisets, num_rank_multisets, rank + 1, num_cards + count, rank_key_sum + count * rank_keys[rank], masks);
+        add_rank_to_rank_count_masks(1 << rank, &masks[0], &masks[1], &masks[2], &masks[3]);
+    }
+}
+
+int compare_rank_multisets(const void* a, const void* b) {
+    uint32_t first = ((RankMultiset*) a)->rank_key_sum;
+    uint32_t second = ((RankMultiset*) b)->rank_key_sum;
+    return first < second ? -1 : first > second;
+}
 
-        if (community_cards_copy.count < 3) {
-            deal_the_flop(&community_cards_copy, &possible_deck, &possible_burned_cards);
+uint32_t* rank_key_sum_row_sizes;
+
+int compare_rank_key_sum_rows_by_decreasing_size(const void* a, const void* b) {
+    return (int) rank_key_sum_row_sizes[*(uint32_t*) b] - (int) rank_key_sum_row_sizes[*(uint32_t*) a];
+}
+
+// Builds the perfect hash by placing the rows, largest first, at the first offset past the previous row's where none
+// of their columns lands on a taken slot. Searching from the previous row's offset rather than from 0 keeps the
+// build to a few tens of milliseconds, for a table about 2.6 times the number of multisets.
+void init_rank_key_sum_score_table() {
+    for (uint8_t card_index = 0; card_index < STANDARD_DECK_SIZE; ++card_index) {
+        card_index_to_suit[card_index] = card_index / NUM_CARD_RANKS;
+        card_index_to_rank_bit[card_index] = 1 << (card_index % NUM_CARD_RANKS);
+        card_index_to_rank_key[card_index] = rank_keys[card_index % NUM_CARD_RANKS];
+    }
+
+    RankMultiset* rank_multisets = malloc(NUM_SEVEN_CARD_RANK_MULTISETS * sizeof(RankMultiset));
+    uint32_t num_rank_multisets = 0;
+    uint16_t rank_count_masks[4] = {0, 0, 0, 0};
+    enumerate_seven_card_rank_multisets(rank_multisets, &num_rank_multisets, 0, 0, 0, rank_count_masks);
+    qsort(rank_multisets, num_rank_multisets, sizeof(RankMultiset), compare_rank_multisets);
+
+    uint32_t* row_starts = calloc(NUM_RANK_KEY_SUM_ROWS + 1, sizeof(uint32_t));
+    uint32_t* rows = malloc(NUM_RANK_KEY_SUM_ROWS * sizeof(uint32_t));
+    rank_key_sum_row_sizes = calloc(NUM_RANK_KEY_SUM_ROWS, sizeof(uint32_t));
+    uint32_t i, j;
+    for (i = 0; i < num_rank_multisets; ++i) {
+        ++rank_key_sum_row_sizes[rank_multisets[i].rank_key_sum >> RANK_KEY_SUM_ROW_SHIFT];
+    }
+    for (i = 0; i < NUM_RANK_KEY_SUM_ROWS; ++i) {
+        row_starts[i + 1] = row_starts[i] + rank_key_sum_row_sizes[i];
+        rows[i] = i;
+    }
+    qsort(rows, NUM_RANK_KEY_SUM_ROWS, sizeof(uint32_t), compare_rank_key_sum_rows_by_decreasing_size);
+
+    // the search always stops at the end of the table at the latest, so each row grows it by at most one row's width
+    uint32_t max_table_size = NUM_RANK_KEY_SUM_ROWS << RANK_KEY_SUM_ROW_SHIFT;
+    uint8_t* taken = calloc(max_table_size, sizeof(uint8_t));
+    rank_key_sum_score_table = calloc(max_table_size, sizeof(uint32_t));
+    rank_key_sum_score_table_size = 0;
+    uint32_t first_free_slot = 0;
+    uint32_t previous_slot = 0;
+    for (i = 0; i < NUM_RANK_KEY_SUM_ROWS && rank_key_sum_row_sizes[rows[i]] > 0; ++i) {
+        RankMultiset* row = &rank_multisets[row_starts[rows[i]]];
+        uint32_t row_size = rank_key_sum_row_sizes[rows[i]];
+        uint32_t first_column = row[0].rank_key_sum & RANK_KEY_SUM_COLUMN_MASK;
+        uint32_t slot = previous_slot > first_free_slot ? previous_slot : first_free_slot;
+        for (;; ++slot) {
+            if (slot < first_column || taken[slot] == true) {
+                continue;
+            }
+            uint32_t offset = slot - first_column;
+            for (j = 1; j < row_size && taken[offset + (row[j].rank_key_sum & RANK_KEY_SUM_COLUMN_MASK)] == false; ++j);
+            if (j == row_size) {
+                break;
+            }
+        }
+        uint32_t offset = slot - first_column;
+        rank_key_sum_row_offsets[rows[i]] = offset;
+        for (j = 0; j < row_size; ++j) {
+            uint32_t score_slot = offset + (row[j].rank_key_sum & RANK_KEY_SUM_COLUMN_MASK);
+            taken[score_slot] = true;
+            rank_key_sum_score_table[score_slot] = row[j].score;
+            if (score_slot + 1 > rank_key_sum_score_table_size) {
+                rank_key_sum_score_table_size = score_slot + 1;
+            }
         }
-        if (community_cards_copy.count < 4) {
-            deal_the_turn(&community_cards_copy, &possible_deck, &possible_burned_cards);
+        while (taken[first_free_slot] == true) {
+            ++first_free_slot;
         }
-        if (community_cards_copy.count < 5) {
-            deal_the_river(&community_cards_copy, &possible_deck, &possible_burned_cards);
+        previous_slot = slot;
+    }
+
+    rank_key_sum_score_table = realloc(rank_key_sum_score_table, rank_key_sum_score_table_size * sizeof(uint32_t));
+    free(taken);
+    free(rank_key_sum_row_sizes);
+    free(rows);
+    free(row_starts);
+    free(rank_multisets);
+}
+
+BoardState get_board_state(CardMask community_cards) {
+    BoardState res;
+    res.num_cards = get_card_mask_count(community_cards);
+    res.rank_key_sum = 0;
+    res.singles = 0;
+    res.pairs = 0;
+    res.trips = 0;
+    res.quads = 0;
+    res.flush_suit = NUM_SUITS;
+    res.flush_suit_rank_mask = 0;
+    for (uint8_t suit = MIN_SUIT; suit <= MAX_SUIT; ++suit) {
+        uint16_t suit_rank_mask = get_suit_rank_mask(community_cards, suit);
+        res.quads |= res.trips & suit_rank_mask;
+        res.trips |= res.pairs & suit_rank_mask;
+        res.pairs |= res.singles & suit_rank_mask;
+        res.singles |= suit_rank_mask;
+        // with 2 hole cards, a flush needs 3 of the suit on the board, which only one suit can have
+        if (__builtin_popcount(suit_rank_mask) >= HAND_LENGTH - NUM_HOLE_CARDS_PER_PLAYER) {
+            res.flush_suit = suit;
+            res.flush_suit_rank_mask = suit_rank_mask;
         }
+    }
+    for (CardMask cards = community_cards; cards != 0; cards &= cards - 1) {
+        res.rank_key_sum += card_index_to_rank_key[__builtin_ctzll(cards)];
+    }
+    return res;
+}
 
-        double players_equities[MAX_NUM_PLAYERS];
+// Same as get_board_state(board_cards | added_cards), from the state of the board's cards
+BoardState add_cards_to_board_state(BoardState* board_state, CardMask board_cards, CardMask added_cards) {
+    if (board_state->num_cards == 0) {
+        return get_board_state(added_cards);
+    }
+    BoardState res = *board_state;
+    res.num_cards += get_card_mask_count(added_cards);
+    for (CardMask cards = added_cards; cards != 0; cards &= cards - 1) {
+        uint8_t card_index = __builtin_ctzll(cards);
+        res.rank_key_sum += card_index_to_rank_key[card_index];
+        add_rank_to_rank_count_masks(card_index_to_rank_bit[card_index], &res.singles, &res.pairs, &res.trips, &res.quads);
+        uint16_t suit_rank_mask = get_suit_rank_mask(board_cards | added_cards, card_index_to_suit[card_index]);
+        if (__builtin_popcount(suit_rank_mask) >= HAND_LENGTH - NUM_HOLE_CARDS_PER_PLAYER) {
+            res.flush_suit = card_index_to_suit[card_index];
+            res.flush_suit_rank_mask = suit_rank_mask;
+        }
+    }
+    return res;
+}
 
-        set_players_equities(players_equities, &game->players, community_cards_copy.cards);
+// Same score as get_player_strongest_hand_from_lookup_tables, from the board state and the two hole cards only
+uint32_t evaluate_hole_cards_on_board(BoardState* board_state, CardMask hole_cards) {
+    uint8_t first_card_index = __builtin_ctzll(hole_cards);
+    uint8_t second_card_index = 63 - __builtin_clzll(hole_cards);
 
-        for (uint8_t i = 0; i < MIN_NUM_PLAYERS; ++i) {
-            wins_distribution[i] += players_equities[i];
+    if (board_state->flush_suit != NUM_SUITS) {
+        uint16_t flush_suit_rank_mask = board_state->flush_suit_rank_mask;
+        if (card_index_to_suit[first_card_index] == board_state->flush_suit) {
+            flush_suit_rank_mask |= card_index_to_rank_bit[first_card_index];
+        }
+        if (card_index_to_suit[second_card_index] == board_state->flush_suit) {
+            flush_suit_rank_mask |= card_index_to_rank_bit[second_card_index];
+        }
+        if (flush_score_table[flush_suit_rank_mask] != 0) {
+            return flush_score_table[flush_suit_rank_mask];
         }
     }
-    for (uint8_t i = 0; i < MIN_NUM_PLAYERS; ++i) {
-        winning_probability_distribution[i] = wins_distribution[i] / iters;
+
+    if (board_state->num_cards == MAX_NUM_COMMUNITY_CARDS) {
+        uint32_t rank_key_sum = board_state->rank_key_sum + card_index_to_rank_key[first_card_index] + card_index_to_rank_key[second_card_index];
+        return rank_key_sum_score_table[rank_key_sum_row_offsets[rank_key_sum >> RANK_KEY_SUM_ROW_SHIFT] + (rank_key_sum & RANK_KEY_SUM_COLUMN_MASK)];
     }
+
+    uint16_t singles = board_state->singles;
+    uint16_t pairs = board_state->pairs;
+    uint16_t trips = board_state->trips;
+    uint16_t quads = board_state->quads;
+    add_rank_to_rank_count_masks(card_index_to_rank_bit[first_card_index], &singles, &pairs, &trips, &quads);
+    add_rank_to_rank_count_masks(card_index_to_rank_bit[second_card_index], &singles, &pairs, &trips, &quads);
+    return evaluate_rank_count_masks(singles, pairs, trips, quads);
 }
 
-void simulate_game() {
+// #############################################
+// Batch hand evaluator
+// #############################################
+
+// Scores count hands given as structure-of-arrays (hole cards and community cards of hand i at index i).
+// The SIMD kernels compute every hand rank's candidate score with the lookup tables and keep the best valid one,
+// which is what the scalar evaluator's branches pick.
 
-    Game game = { .deck = get_shuffled_deck(&original_unshuffled_standard_deck), .players = init_players(), .burned_cards = init_burned_cards(), .community_cards = init_community_cards() };
-    
-    deal_hole_cards(game.players.players, &game.deck);
+// batch hand evaluation kernels:
+#define SCALAR_KERNEL 0
+#define AVX2_KERNEL 1
+#define AVX512_KERNEL 2
+#define AUTOMATIC_KERNEL 3
 
-    calculate_winning_probability_distribution(&game);
-    display_table(&game.players, &game.community_cards);
+typedef void (*BatchHandEvaluator)(const CardMask* hole_cards, const CardMask* community_cards, uint32_t* strengths, uint32_t count);
 
-    deal_the_flop(&game.community_cards, &game.deck, &game.burned_cards);
+const char* batch_hand_evaluation_kernel_names[] = { "scalar", "avx2", "avx512" };
+uint8_t requested_batch_hand_evaluation_kernel = AUTOMATIC_KERNEL;
+uint8_t batch_hand_evaluation_kernel = SCALAR_KERNEL;
+BatchHandEvaluator evaluate_hands = NULL;
 
-    calculate_winning_probability_distribution(&game);
-    display_table(&game.players, &game.community_cards);
+void evaluate_hands_scalar(const CardMask* hole_cards, const CardMask* community_cards, uint32_t* strengths, uint32_t count) {
+    for (uint32_t i = 0; i < count; ++i) {
+        strengths[i] = evaluate_card_mask(hole_cards[i] | community_cards[i]);
+    }
+}
 
-    deal_the_turn(&game.community_cards, &game.deck, &game.burned_cards);
+#if defined(__x86_64__)
+
+// Highest set bit of each (non-zero, below 2^24) lane, read off the exponent of its float conversion
+__attribute__((target("avx2"))) static inline __m256i get_highest_ranks_avx2(__m256i rank_masks) {
+    __m256i exponents = _mm256_srli_epi32(_mm256_castps_si256(_mm256_cvtepi32_ps(rank_masks)), 23);
+    return _mm256_sub_epi32(exponents, _mm256_set1_epi32(127));
+}
 
-    calculate_winning_probability_distribution(&game);
-    display_table(&game.players, &game.community_cards);
+__attribute__((target("avx2"))) static inline __m256i get_rank_bits_avx2(__m256i ranks) {
+    return _mm256_sllv_epi32(_mm256_set1_epi32(1), ranks);
+}
 
-    deal_the_river(&game.community_cards, &game.deck, &game.burned_cards);
+__attribute__((target("avx2"))) static inline __m256i gather_avx2(const uint32_t* table, __m256i indices) {
+    return _mm256_i32gather_epi32((const int*) table, indices, 4);
+}
 
-    calculate_winning_probability_distribution(&game);
-    display_table(&game.players, &game.community_cards);
+// Keeps the candidate score in the lanes where it is valid (all ones), if it beats the best so far
+__attribute__((target("avx2"))) static inline __m256i keep_best_avx2(__m256i best, __m256i candidate, __m256i is_valid) {
+    return _mm256_max_epu32(best, _mm256_and_si256(candidate, is_valid));
 }
 
+__attribute__((target("avx2"))) void evaluate_hands_avx2(const CardMask* hole_cards, const CardMask* community_cards, uint32_t* strengths, uint32_t count) {
+    const __m256i deinterleave = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+    const __m256i suit_rank_mask = _mm256_set1_epi32(SUIT_RANK_MASK);
+    const __m256i zero = _mm256_setzero_si256();
+    uint32_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        // low and high 32 bits of the 8 card masks
+        __m256i first_cards = _mm256_or_si256(_mm256_loadu_si256((const __m256i*) &hole_cards[i]), _mm256_loadu_si256((const __m256i*) &community_cards[i]));
+        __m256i second_cards = _mm256_or_si256(_mm256_loadu_si256((const __m256i*) &hole_cards[i + 4]), _mm256_loadu_si256((const __m256i*) &community_cards[i + 4]));
+        first_cards = _mm256_permutevar8x32_epi32(first_cards, deinterleave);
+        second_cards = _mm256_permutevar8x32_epi32(second_cards, deinterleave);
+        __m256i low_bits = _mm256_permute2x128_si256(first_cards, second_cards, 0x20);
+        __m256i high_bits = _mm256_permute2x128_si256(first_cards, second_cards, 0x31);
 
+        __m256i clubs = _mm256_and_si256(low_bits, suit_rank_mask);
+        __m256i diamonds = _mm256_and_si256(_mm256_srli_epi32(low_bits, 13), suit_rank_mask);
+        __m256i hearts = _mm256_and_si256(_mm256_or_si256(_mm256_srli_epi32(low_bits, 26), _mm256_slli_epi32(high_bits, 6)), suit_rank_mask);
+        __m256i spades = _mm256_and_si256(_mm256_srli_epi32(high_bits, 7), suit_rank_mask);
 
-HoleCards get_hole_cards_from_input() {
+        __m256i best = _mm256_max_epu32(_mm256_max_epu32(gather_avx2(flush_score_table, clubs), gather_avx2(flush_score_table, diamonds)), _mm256_max_epu32(gather_avx2(flush_score_table, hearts), gather_avx2(flush_score_table, spades)));
 
-    char hole_cards[8];
+        __m256i singles = _mm256_or_si256(_mm256_or_si256(clubs, diamonds), _mm256_or_si256(hearts, spades));
+        __m256i pairs = _mm256_or_si256(_mm256_or_si256(_mm256_and_si256(clubs, diamonds), _mm256_and_si256(hearts, spades)), _mm256_and_si256(_mm256_xor_si256(clubs, diamonds), _mm256_xor_si256(hearts, spades)));
+        __m256i trips = _mm256_or_si256(_mm256_and_si256(_mm256_and_si256(clubs, diamonds), _mm256_or_si256(hearts, spades)), _mm256_and_si256(_mm256_and_si256(hearts, spades), _mm256_or_si256(clubs, diamonds)));
+        __m256i quads = _mm256_and_si256(_mm256_and_si256(clubs, diamonds), _mm256_and_si256(hearts, spades));
 
-    printf("\nEnter your hole cards: ");
+        __m256i quads_rank = get_highest_ranks_avx2(quads);
+        __m256i quads_score = _mm256_add_epi32(_mm256_set1_epi32(FOUR_OF_A_KIND * HAND_RANK_WEIGHT), _mm256_mullo_epi32(quads_rank, _mm256_set1_epi32(KICKER_1_WEIGHT)));
+        quads_score = _mm256_add_epi32(quads_score, _mm256_mullo_epi32(gather_avx2(kickers_score_table[1], _mm256_andnot_si256(get_rank_bits_avx2(quads_rank), singles)), _mm256_set1_epi32(KICKER_2_WEIGHT)));
+        best = keep_best_avx2(best, quads_score, _mm256_xor_si256(_mm256_cmpeq_epi32(quads, zero), _mm256_set1_epi32(-1)));
 
-    fgets(hole_cards, sizeof(hole_cards), stdin);
+        __m256i trips_rank = get_highest_ranks_avx2(trips);
+        __m256i has_trips = _mm256_xor_si256(_mm256_cmpeq_epi32(trips, zero), _mm256_set1_epi32(-1));
+        __m256i full_house_pairs = _mm256_andnot_si256(get_rank_bits_avx2(trips_rank), pairs);
+        __m256i full_house_score = _mm256_add_epi32(_mm256_set1_epi32(FULL_HOUSE * HAND_RANK_WEIGHT), _mm256_mullo_epi32(trips_rank, _mm256_set1_epi32(KICKER_1_WEIGHT)));
+        full_house_score = _mm256_add_epi32(full_house_score, _mm256_mullo_epi32(get_highest_ranks_avx2(full_house_pairs), _mm256_set1_epi32(KICKER_2_WEIGHT)));
+        best = keep_best_avx2(best, full_house_score, _mm256_andnot_si256(_mm256_cmpeq_epi32(full_house_pairs, zero), has_trips));
 
-    printf("%s.", hole_cards);
-    
-    HoleCards res = init_hole_cards();
+        best = _mm256_max_epu32(best, gather_avx2(straight_score_table, singles));
 
-    return res;
+        __m256i trips_score = _mm256_add_epi32(_mm256_set1_epi32(THREE_OF_A_KIND * HAND_RANK_WEIGHT), _mm256_mullo_epi32(trips_rank, _mm256_set1_epi32(KICKER_1_WEIGHT)));
+        trips_score = _mm256_add_epi32(trips_score, _mm256_mullo_epi32(gather_avx2(kickers_score_table[2], _mm256_andnot_si256(get_rank_bits_avx2(trips_rank), singles)), _mm256_set1_epi32(KICKER_3_WEIGHT)));
+        best = keep_best_avx2(best, trips_score, has_trips);
+
+        __m256i high_pair_rank = get_highest_ranks_avx2(pairs);
+        __m256i high_pair_bit = get_rank_bits_avx2(high_pair_rank);
+        __m256i remaining_pairs = _mm256_andnot_si256(high_pair_bit, pairs);
+        __m256i low_pair_rank = get_highest_ranks_avx2(remaining_pairs);
+        __m256i two_pairs_score = _mm256_add_epi32(_mm256_set1_epi32(TWO_PAIRS * HAND_RANK_WEIGHT), _mm256_mullo_epi32(high_pair_rank, _mm256_set1_epi32(KICKER_1_WEIGHT)));
+        two_pairs_score = _mm256_add_epi32(two_pairs_score, _mm256_mullo_epi32(low_pair_rank, _mm256_set1_epi32(KICKER_2_WEIGHT)));
+        two_pairs_score = _mm256_add_epi32(two_pairs_score, _mm256_mullo_epi32(gather_avx2(kickers_score_table[1], _mm256_andnot_si256(_mm256_or_si256(high_pair_bit, get_rank_bits_avx2(low_pair_rank)), singles)), _mm256_set1_epi32(KICKER_3_WEIGHT)));
+        best = keep_best_avx2(best, two_pairs_score, _mm256_xor_si256(_mm256_cmpeq_epi32(remaining_pairs, zero), _mm256_set1_epi32(-1)));
+
+        __m256i pair_score = _mm256_add_epi32(_mm256_set1_epi32(PAIR * HAND_RANK_WEIGHT), _mm256_mullo_epi32(high_pair_rank, _mm256_set1_epi32(KICKER_1_WEIGHT)));
+        pair_score = _mm256_add_epi32(pair_score, _mm256_mullo_epi32(gather_avx2(kickers_score_table[3], _mm256_andnot_si256(high_pair_bit, singles)), _mm256_set1_epi32(KICKER_4_WEIGHT)));
+        best = keep_best_avx2(best, pair_score, _mm256_xor_si256(_mm256_cmpeq_epi32(pairs, zero), _mm256_set1_epi32(-1)));
+
+        best = _mm256_max_epu32(best, gather_avx2(kickers_score_table[HAND_LENGTH], singles));
+
+        _mm256_storeu_si256((__m256i*) &strengths[i], best);
+    }
+    evaluate_hands_scalar(&hole_cards[i], &community_cards[i], &strengths[i], count - i);
 }
 
-CommunityCards get_community_cards_from_input() {
-    CommunityCards res = init_community_cards();
-    return res;
+__attribute__((target("avx512f"))) static inline __m512i get_highest_ranks_avx512(__m512i rank_masks) {
+    __m512i exponents = _mm512_srli_epi32(_mm512_castps_si512(_mm512_cvtepi32_ps(rank_masks)), 23);
+    return _mm512_sub_epi32(exponents, _mm512_set1_epi32(127));
 }
 
+__attribute__((target("avx512f"))) static inline __m512i get_rank_bits_avx512(__m512i ranks) {
+    return _mm512_sllv_epi32(_mm512_set1_epi32(1), ranks);
+}
 
-void tool() {
-    HoleCards users_hole_cards = get_hole_cards_from_input();
-    printf("\nNumber of user's hole cards: %d\n", users_hole_cards.count);
-    printf("User's hole card 0 rank: %d\n", users_hole_cards.cards[0].rank);
-    printf("User's hole card 0 suit: %d\n", users_hole_cards.cards[0].suit);
-    printf("User's hole card 1 rank: %d\n", users_hole_cards.cards[1].rank);
-    printf("User's hole card 1 suit: %d\n", users_hole_cards.cards[1].suit);
+__attribute__((target("avx512f"))) static inline __m512i gather_avx512(const uint32_t* table, __m512i indices) {
+    return _mm512_i32gather_epi32(indices, (const int*) table, 4);
 }
 
+__attribute__((target("avx512f"))) void evaluate_hands_avx512(const CardMask* hole_cards, const CardMask* community_cards, uint32_t* strengths, uint32_t count) {
+    const __m512i suit_rank_mask = _mm512_set1_epi32(SUIT_RANK_MASK);
+    uint32_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        // low and high 32 bits of the 16 card masks
+        __m512i first_cards = _mm512_or_si512(_mm512_loadu_si512(&hole_cards[i]), _mm512_loadu_si512(&community_cards[i]));
+        __m512i second_cards = _mm512_or_si512(_mm512_loadu_si512(&hole_cards[i + 8]), _mm512_loadu_si512(&community_cards[i + 8]));
+        __m512i low_bits = _mm512_inserti64x4(_mm512_castsi256_si512(_mm512_cvtepi64_epi32(first_cards)), _mm512_cvtepi64_epi32(second_cards), 1);
+        __m512i high_bits = _mm512_inserti64x4(_mm512_castsi256_si512(_mm512_cvtepi64_epi32(_mm512_srli_epi64(first_cards, 32))), _mm512_cvtepi64_epi32(_mm512_srli_epi64(second_cards, 32)), 1);
 
-int main() {
+        __m512i clubs = _mm512_and_si512(low_bits, suit_rank_mask);
+        __m512i diamonds = _mm512_and_si512(_mm512_srli_epi32(low_bits, 13), suit_rank_mask);
+        __m512i hearts = _mm512_and_si512(_mm512_or_si512(_mm512_srli_epi32(low_bits, 26), _mm512_slli_epi32(high_bits, 6)), suit_rank_mask);
+        __m512i spades = _mm512_and_si512(_mm512_srli_epi32(high_bits, 7), suit_rank_mask);
 
-    init();
+        __m512i best = _mm512_max_epu32(_mm512_max_epu32(gather_avx512(flush_score_table, clubs), gather_avx512(flush_score_table, diamonds)), _mm512_max_epu32(gather_avx512(flush_score_table, hearts), gather_avx512(flush_score_table, spades)));
+
+        __m512i singles = _mm512_or_si512(_mm512_or_si512(clubs, diamonds), _mm512_or_si512(hearts, spades));
+        __m512i pairs = _mm512_or_si512(_mm512_or_si512(_mm512_and_si512(clubs, diamonds), _mm512_and_si512(hearts, spades)), _mm512_and_si512(_mm512_xor_si512(clubs, diamonds), _mm512_xor_si512(hearts, spades)));
+        __m512i trips = _mm512_or_si512(_mm512_and_si512(_mm512_and_si512(clubs, diamonds), _mm512_or_si512(hearts, spades)), _mm512_and_si512(_mm512_and_si512(hearts, spades), _mm512_or_si512(clubs, diamonds)));
+        __m512i quads = _mm512_and_si512(_mm512_and_si512(clubs, diamonds), _mm512_and_si512(hearts, spades));
+
+        __m512i quads_rank = get_highest_ranks_avx512(quads);
+        __m512i quads_score = _mm512_add_epi32(_mm512_set1_epi32(FOUR_OF_A_KIND * HAND_RANK_WEIGHT), _mm512_mullo_epi32(quads_rank, _mm512_set1_epi32(KICKER_1_WEIGHT)));
+        quads_score = _mm512_add_epi32(quads_score, _mm512_mullo_epi32(gather_avx512(kickers_score_table[1], _mm512_andnot_si512(get_rank_bits_avx512(quads_rank), singles)), _mm512_set1_epi32(KICKER_2_WEIGHT)));
+        best = _mm512_mask_max_epu32(best, _mm512_test_epi32_mask(quads, quads), best, quads_score);
+
+        __m512i trips_rank = get_highest_ranks_avx512(trips);
+        __mmask16 has_trips = _mm512_test_epi32_mask(trips, trips);
+        __m512i full_house_pairs = _mm512_andnot_si512(get_rank_bits_avx512(trips_rank), pairs);
+        __m512i full_house_score = _mm512_add_epi32(_mm512_set1_epi32(FULL_HOUSE * HAND_RANK_WEIGHT), _mm512_mullo_epi32(trips_rank, _mm512_set1_epi32(KICKER_1_WEIGHT)));
+        full_house_score = _mm512_add_epi32(full_house_score, _mm512_mullo_epi32(get_highest_ranks_avx512(full_house_pairs), _mm512_set1_epi32(KICKER_2_WEIGHT)));
+        best = _mm512_mask_max_epu32(best, has_trips & _mm512_test_epi32_mask(full_house_pairs, full_house_pairs), best, full_house_score);
+
+        best = _mm512_max_epu32(best, gather_avx512(straight_score_table, singles));
+
+        __m512i trips_score = _mm512_add_epi32(_mm512_set1_epi32(THREE_OF_A_KIND * HAND_RANK_WEIGHT), _mm512_mullo_epi32(trips_rank, _mm512_set1_epi32(KICKER_1_WEIGHT)));
+        trips_score = _mm512_add_epi32(trips_score, _mm512_mullo_epi32(gather_avx512(kickers_score_table[2], _mm512_andnot_si512(get_rank_bits_avx512(trips_rank), singles)), _mm512_set1_epi32(KICKER_3_WEIGHT)));
+        best = _mm512_mask_max_epu32(best, has_trips, best, trips_score);
+
+        __m512i high_pair_rank = get_highest_ranks_avx512(pairs);
+        __m512i high_pair_bit = get_rank_bits_avx512(high_pair_rank);
+        __m512i remaining_pairs = _mm512_andnot_si512(high_pair_bit, pairs);
+        __m512i low_pair_rank = get_highest_ranks_avx512(remaining_pairs);
+        __m512i two_pairs_score = _mm512_add_epi32(_mm512_set1_epi32(TWO_PAIRS * HAND_RANK_WEIGHT), _mm512_mullo_epi32(high_pair_rank, _mm512_set1_epi32(KICKER_1_WEIGHT)));
+        two_pairs_score = _mm512_add_epi32(two_pairs_score, _mm512_mullo_epi32(low_pair_rank, _mm512_set1_epi32(KICKER_2_WEIGHT)));
+        two_pairs_score = _mm512_add_epi32(two_pairs_score, _mm512_mullo_epi32(gather_avx512(kickers_score_table[1], _mm512_andnot_si512(_mm512_or_si512(high_pair_bit, get_rank_bits_avx512(low_pair_rank)), singles)), _mm512_set1_epi32(KICKER_3_WEIGHT)));
+        best = _mm512_mask_max_epu32(best, _mm512_test_epi32_mask(remaining_pairs, remaining_pairs), best, two_pairs_score);
 
-    tool();
+        __m512i pair_score = _mm512_add_epi32(_mm512_set1_epi32(PAIR * HAND_RANK_WEIGHT), _mm512_mullo_epi32(high_pair_rank, _mm512_set1_epi32(KICKER_1_WEIGHT)));
+        pair_score = _mm512_add_epi32(pair_score, _mm512_mullo_epi32(gather_avx512(kickers_score_table[3], _mm512_andnot_si512(high_pair_bit, singles)), _mm512_set1_epi32(KICKER_4_WEIGHT)));
+        best = _mm512_mask_max_epu32(best, _mm512_test_epi32_mask(pairs, pairs), best, pair_score);
+
+        best = _mm512_max_epu32(best, gather_avx512(kickers_score_table[HAND_LENGTH], singles));
+
+        _mm512_storeu_si512(&strengths[i], best);
+    }
+    evaluate_hands_scalar(&hole_cards[i], &community_cards[i], &strengths[i], count - i);
+}
+
+#endif
+
+bool is_batch_hand_evaluation_kernel_supported(uint8_t kernel) {
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (kernel == AVX2_KERNEL) {
+        return __builtin_cpu_supports("avx2");
+    }
+    if (kernel == AVX512_KERNEL) {
+        return __builtin_cpu_supports("avx512f");
+    }
+#endif
+    return kernel == SCALAR_KERNEL;
+}
+
+void select_batch_hand_evaluation_kernel(uint8_t kernel) {
+    batch_hand_evaluation_kernel = kernel;
+    evaluate_hands = evaluate_hands_scalar;
+#if defined(__x86_64__)
+    if (kernel == AVX2_KERNEL) {
+        evaluate_hands = evaluate_hands_avx2;
+    }
+    else if (kernel == AVX512_KERNEL) {
+        evaluate_hands = evaluate_hands_avx512;
+    }
+#endif
+}
+
+// Picks the widest kernel the CPU supports, unless one was requested
+void init_batch_hand_evaluator() {
+    uint8_t kernel = SCALAR_KERNEL;
+    if (requested_batch_hand_evaluation_kernel != AUTOMATIC_KERNEL) {
+        kernel = requested_batch_hand_evaluation_kernel;
+        if (is_batch_hand_evaluation_kernel_supported(kernel) == false) {
+            fprintf(stderr, "This CPU does not support the %s kernel, using the scalar one\n", batch_hand_evaluation_kernel_names[kernel]);
+            kernel = SCALAR_KERNEL;
+        }
+    }
+    else if (is_batch_hand_evaluation_kernel_supported(AVX512_KERNEL) == true) {
+        kernel = AVX512_KERNEL;
+    }
+    else if (is_batch_hand_evaluation_kernel_supported(AVX2_KERNEL) == true) {
+        kernel = AVX2_KERNEL;
+    }
+    select_batch_hand_evaluation_kernel(kernel);
+}
+
+// The lookup-table evaluator works out the community cards once, then only adds each player's hole cards
+void set_players_strongest_hands(uint32_t* players_strongest_hands, CardMask* players_hole_cards, uint8_t num_players, CardMask community_cards) {
+    if (hand_evaluator == BRUTE_FORCE_EVALUATOR) {
+        for (uint8_t i = 0; i < num_players; ++i) {
+            players_strongest_hands[i] = get_player_strongest_hand_by_brute_force(players_hole_cards[i], community_cards);
+        }
+        return;
+    }
+    BoardState board_state = get_board_state(community_cards);
+    for (uint8_t i = 0; i < num_players; ++i) {
+        players_strongest_hands[i] = evaluate_hole_cards_on_board(&board_state, players_hole_cards[i]);
+    }
+}
+
+// Same as set_players_strongest_hands on the fixed board cards plus the dealt ones, with the fixed cards' state
+// worked out once for all the showdowns
+void set_players_strongest_hands_on_dealt_board(uint32_t* players_strongest_hands, CardMask* players_hole_cards, uint8_t num_players, BoardState* fixed_board_state, CardMask fixed_board_cards, CardMask dealt_board_cards) {
+    if (hand_evaluator == BRUTE_FORCE_EVALUATOR) {
+        set_players_strongest_hands(players_strongest_hands, players_hole_cards, num_players, fixed_board_cards | dealt_board_cards);
+        return;
+    }
+    BoardState board_state = add_cards_to_board_state(fixed_board_state, fixed_board_cards, dealt_board_cards);
+    for (uint8_t i = 0; i < num_players; ++i) {
+        players_strongest_hands[i] = evaluate_hole_cards_on_board(&board_state, players_hole_cards[i]);
+    }
+}
+
+void set_players_equities_from_strongest_hands(double* players_equities, uint32_t* players_strongest_hands, uint8_t num_players) {
+    uint32_t strongest_hand = 0;
+    uint8_t num_winning_players = 0;
+    uint8_t i;
+    for (i = 0; i < num_players; ++i) {
+        if (players_strongest_hands[i] > strongest_hand) {
+            strongest_hand = players_strongest_hands[i];
+            num_winning_players = 1;
+        }
+        else if (players_strongest_hands[i] == strongest_hand) {
+            ++num_winning_players;
+        }
+    }
+    double equity_for_each_winner = (double) 1 / num_winning_players;
+    for (i = 0; i < num_players; ++i) {
+        players_equities[i] = players_strongest_hands[i] == strongest_hand ? equity_for_each_winner : 0;
+    }
+}
+
+void set_players_equities(double* players_equities, CardMask* players_hole_cards, uint8_t num_players, CardMask community_cards) {
+    uint32_t players_strongest_hands[MAX_NUM_PLAYERS];
+    set_players_strongest_hands(players_strongest_hands, players_hole_cards, num_players, community_cards);
+    set_players_equities_from_strongest_hands(players_equities, players_strongest_hands, num_players);
+}
+
+
+
+
+
+
+
+// #############################################
+// Hand ranges
+// #############################################
+
+// The combination of the cards with indices i < j has index j * (j - 1) / 2 + i
+CardMask hole_cards_combinations[NUM_HOLE_CARDS_COMBINATIONS];
+
+void init_hole_cards_combinations() {
+    for (uint8_t j = 1; j < STANDARD_DECK_SIZE; ++j) {
+        for (uint8_t i = 0; i < j; ++i) {
+            hole_cards_combinations[j * (j - 1) / 2 + i] = ((CardMask) 1 << i) | ((CardMask) 1 << j);
+        }
+    }
+}
+
+uint16_t get_hole_cards_combination_index(CardMask hole_cards) {
+    uint8_t i = __builtin_ctzll(hole_cards);
+    uint8_t j = 63 - __builtin_clzll(hole_cards);
+    return j * (j - 1) / 2 + i;
+}
+
+void init_range(Range* range) {
+    memset(range, 0, sizeof(Range));
+}
+
+// Vose's alias method over the combinations that don't use any dead card: slot i keeps live_combinations[i]
+// with probability alias_thresholds[i] / 2^32, and otherwise gives its alias slot's. Fails if no combination is left.
+bool init_range_sampler(Range* range, CardMask dead_cards) {
+    double total_weight = 0;
+    range->num_live_combinations = 0;
+    uint16_t i;
+    for (i = 0; i < NUM_HOLE_CARDS_COMBINATIONS; ++i) {
+        if (range->weights[i] > 0 && (hole_cards_combinations[i] & dead_cards) == 0) {
+            range->live_combinations[range->num_live_combinations++] = i;
+            total_weight += range->weights[i];
+        }
+    }
+    if (range->num_live_combinations == 0) {
+        return false;
+    }
+    double scaled_weights[NUM_HOLE_CARDS_COMBINATIONS];
+    uint16_t small_slots[NUM_HOLE_CARDS_COMBINATIONS];
+    uint16_t large_slots[NUM_HOLE_CARDS_COMBINATIONS];
+    uint16_t num_small_slots = 0;
+    uint16_t num_large_slots = 0;
+    for (i = 0; i < range->num_live_combinations; ++i) {
+        scaled_weights[i] = range->weights[range->live_combinations[i]] * range->num_live_combinations / total_weight;
+        if (scaled_weights[i] < 1) {
+            small_slots[num_small_slots++] = i;
+        }
+        else {
+            large_slots[num_large_slots++] = i;
+        }
+    }
+    while (num_small_slots > 0 && num_large_slots > 0) {
+        uint16_t small_slot = small_slots[--num_small_slots];
+        uint16_t large_slot = large_slots[--num_large_slots];
+        range->alias_thresholds[small_slot] = scaled_weights[small_slot] * 4294967296.0;
+        range->aliases[small_slot] = large_slot;
+        scaled_weights[large_slot] -= 1 - scaled_weights[small_slot];
+        if (scaled_weights[large_slot] < 1) {
+            small_slots[num_small_slots++] = large_slot;
+        }
+        else {
+            large_slots[num_large_slots++] = large_slot;
+        }
+    }
+    // what is left is full, up to rounding errors
+    while (num_large_slots > 0) {
+        uint16_t slot = large_slots[--num_large_slots];
+        range->alias_thresholds[slot] = UINT32_MAX;
+        range->aliases[slot] = slot;
+    }
+    while (num_small_slots > 0) {
+        uint16_t slot = small_slots[--num_small_slots];
+        range->alias_thresholds[slot] = UINT32_MAX;
+        range->aliases[slot] = slot;
+    }
+    return true;
+}
+
+uint16_t draw_range_combination(Range* range, RandomNumberGenerator* random_number_generator) {
+    uint16_t slot = ((uint64_t) get_random_number(random_number_generator) * range->num_live_combinations) >> 32;
+    if (get_random_number(random_number_generator) >= range->alias_thresholds[slot]) {
+        slot = range->aliases[slot];
+    }
+    return range->live_combinations[slot];
+}
+
+// Players with a range and without known hole cards
+uint8_t get_num_players_with_ranges(Players* players) {
+    uint8_t res = 0;
+    for (uint8_t i = 0; i < players->count; ++i) {
+        if (players->ranges[i] != NULL && players->hole_cards[i].count == 0) {
+            ++res;
+        }
+    }
+    return res;
+}
+
+// Sets up the range samplers against the known cards, failing if a range has no possible combination left
+bool init_range_samplers(Players* players, CardMask known_cards) {
+    for (uint8_t i = 0; i < players->count; ++i) {
+        if (players->ranges[i] != NULL && players->hole_cards[i].count == 0 && init_range_sampler(players->ranges[i], known_cards) == false) {
+            return false;
+        }
+    }
+    return true;
+}
+
+#define MAX_NUM_RANGE_DRAW_ATTEMPTS 1000000
+
+// Draws the hole cards of the players with ranges, all again whenever two of them clash, so that
+// the combinations come from the joint distribution. The samplers already leave out the known cards.
+// Fails if every attempt clashes: each range can be dealt on its own, but they can't be dealt together.
+bool draw_hole_cards_from_ranges(Players* players, CardMask* players_hole_cards, uint16_t* players_combinations, CardMask* range_hole_cards, RandomNumberGenerator* random_number_generator) {
+    for (uint32_t attempt = 0; attempt < MAX_NUM_RANGE_DRAW_ATTEMPTS; ++attempt) {
+        CardMask res = 0;
+        uint8_t i;
+        for (i = 0; i < players->count; ++i) {
+            if (players->ranges[i] == NULL || players->hole_cards[i].count > 0) {
+                continue;
+            }
+            uint16_t combination = draw_range_combination(players->ranges[i], random_number_generator);
+            if ((hole_cards_combinations[combination] & res) != 0) {
+                break;
+            }
+            res |= hole_cards_combinations[combination];
+            players_hole_cards[i] = hole_cards_combinations[combination];
+            players_combinations[i] = combination;
+        }
+        if (i == players->count) {
+            *range_hole_cards = res;
+            return true;
+        }
+    }
+    return false;
+}
+
+// binomial_coefficients[n][k] = n choose k, for the board completions that can be enumerated
+uint64_t binomial_coefficients[STANDARD_DECK_SIZE + 1][MAX_NUM_COMMUNITY_CARDS + 1];
+
+void init_binomial_coefficients() {
+    for (uint8_t n = 0; n <= STANDARD_DECK_SIZE; ++n) {
+        binomial_coefficients[n][0] = 1;
+        for (uint8_t k = 1; k <= MAX_NUM_COMMUNITY_CARDS; ++k) {
+            binomial_coefficients[n][k] = n == 0 ? 0 : binomial_coefficients[n - 1][k - 1] + binomial_coefficients[n - 1][k];
+        }
+    }
+}
+
+void init_globals() {
+    init_card_rank_to_human_readable();
+    init_suit_to_human_readable();
+    init_original_unshuffled_standard_deck();
+    init_hand_evaluator_tables();
+    init_rank_key_sum_score_table();
+    init_batch_hand_evaluator();
+    init_hole_cards_combinations();
+    init_binomial_coefficients();
+}
+
+void init() {
+    init_rand();
+    init_globals();
+}
+
+
+
+
+
+
+// #############################################
+// Profiling
+// #############################################
+
+// Built with -DPROFILE, the trial loops count the events of each stage, and time the stages of one trial in
+// PROFILE_SAMPLING_INTERVAL with the cycle counter; a stage's time is estimated as its mean over the timed events
+// (less the cost of reading the counter) times its number of events. Each thread counts in its own counters, which it adds to the totals with atomic adds
+// when it's done with a simulation. Without PROFILE, the macros are empty and nothing is counted.
+
+// stages:
+#define SETUP_STAGE 0
+#define DRAW_CARDS_STAGE 1
+#define DEAL_HOLE_CARDS_STAGE 2
+#define EVALUATE_STAGE 3
+#define SETTLE_POT_STAGE 4
+#define TALLY_STAGE 5
+#define MERGE_STAGE 6
+#define NUM_PROFILE_STAGES 7
+
+// profile report formats:
+#define NO_PROFILE_REPORT 0
+#define TEXT_PROFILE_REPORT 1
+#define JSON_PROFILE_REPORT 2
+
+uint8_t profile_report_option = NO_PROFILE_REPORT;
+
+#ifdef PROFILE
+
+#define PROFILE_SAMPLING_INTERVAL 64
+
+const char* profile_stage_names[NUM_PROFILE_STAGES] = {"setup", "draw cards", "deal hole cards", "evaluate", "settle pot", "tally", "merge"};
+
+typedef struct {
+    uint64_t num_events[NUM_PROFILE_STAGES];
+    uint64_t num_timed_events[NUM_PROFILE_STAGES];
+    uint64_t num_cycles[NUM_PROFILE_STAGES];
+    uint64_t num_trials;
+} ProfileCounters;
+
+__thread ProfileCounters thread_profile_counters;
+ProfileCounters profile_counters;
+
+// for converting cycles to nanoseconds
+uint64_t profile_start_cycle;
+double profile_start_time;
+// cycles that reading the cycle counter itself adds to a timed stage
+uint64_t cycle_counter_overhead;
+
+static inline uint64_t read_cycle_counter() {
+#if defined(__x86_64__)
+    return __rdtsc();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000ULL + now.tv_nsec;
+#endif
+}
+
+double get_profile_time_in_seconds() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+void init_profile() {
+    profile_start_cycle = read_cycle_counter();
+    profile_start_time = get_profile_time_in_seconds();
+    cycle_counter_overhead = UINT64_MAX;
+    for (uint16_t i = 0; i < 1000; ++i) {
+        uint64_t cycle = read_cycle_counter();
+        uint64_t overhead = read_cycle_counter() - cycle;
+        if (overhead < cycle_counter_overhead) {
+            cycle_counter_overhead = overhead;
+        }
+    }
+}
+
+// Adds the thread's counters to the totals, and resets them
+void flush_profile_counters() {
+    for (uint8_t stage = 0; stage < NUM_PROFILE_STAGES; ++stage) {
+        __atomic_fetch_add(&profile_counters.num_events[stage], thread_profile_counters.num_events[stage], __ATOMIC_RELAXED);
+        __atomic_fetch_add(&profile_counters.num_timed_events[stage], thread_profile_counters.num_timed_events[stage], __ATOMIC_RELAXED);
+        __atomic_fetch_add(&profile_counters.num_cycles[stage], thread_profile_counters.num_cycles[stage], __ATOMIC_RELAXED);
+    }
+    __atomic_fetch_add(&profile_counters.num_trials, thread_profile_counters.num_trials, __ATOMIC_RELAXED);
+    memset(&thread_profile_counters, 0, sizeof(thread_profile_counters));
+}
+
+void print_profile_report(FILE* output, uint8_t format) {
+    ProfileCounters counters;
+    for (uint8_t stage = 0; stage < NUM_PROFILE_STAGES; ++stage) {
+        counters.num_events[stage] = __atomic_load_n(&profile_counters.num_events[stage], __ATOMIC_RELAXED);
+        counters.num_timed_events[stage] = __atomic_load_n(&profile_counters.num_timed_events[stage], __ATOMIC_RELAXED);
+        counters.num_cycles[stage] = __atomic_load_n(&profile_counters.num_cycles[stage], __ATOMIC_RELAXED);
+        uint64_t num_overhead_cycles = counters.num_timed_events[stage] * cycle_counter_overhead;
+        counters.num_cycles[stage] = counters.num_cycles[stage] > num_overhead_cycles ? counters.num_cycles[stage] - num_overhead_cycles : 0;
+    }
+    counters.num_trials = __atomic_load_n(&profile_counters.num_trials, __ATOMIC_RELAXED);
+    double nanoseconds_per_cycle = (get_profile_time_in_seconds() - profile_start_time) * 1e9 / (read_cycle_counter() - profile_start_cycle);
+
+    double estimated_num_cycles[NUM_PROFILE_STAGES];
+    double total_estimated_num_cycles = 0;
+    uint8_t stage;
+    for (stage = 0; stage < NUM_PROFILE_STAGES; ++stage) {
+        estimated_num_cycles[stage] = 0;
+        if (counters.num_timed_events[stage] > 0) {
+            estimated_num_cycles[stage] = (double) counters.num_cycles[stage] / counters.num_timed_events[stage] * counters.num_events[stage];
+        }
+        total_estimated_num_cycles += estimated_num_cycles[stage];
+    }
+
+    if (format == JSON_PROFILE_REPORT) {
+        fprintf(output, "{\"trials\":%llu,\"nanoseconds_per_cycle\":%.4f,\"stages\":[", (unsigned long long) counters.num_trials, nanoseconds_per_cycle);
+        for (stage = 0; stage < NUM_PROFILE_STAGES; ++stage) {
+            fprintf(output, "%s{\"stage\":\"%s\",\"events\":%llu,\"timed_events\":%llu,\"cycles_per_event\":%.1f,\"estimated_seconds\":%.6f}", stage > 0 ? "," : "", profile_stage_names[stage], (unsigned long long) counters.num_events[stage], (unsigned long long) counters.num_timed_events[stage], counters.num_timed_events[stage] > 0 ? (double) counters.num_cycles[stage] / counters.num_timed_events[stage] : 0, estimated_num_cycles[stage] * nanoseconds_per_cycle * 1e-9);
+        }
+        fprintf(output, "]}\n");
+        return;
+    }
+    fprintf(output, "Profile of %llu trials (1 in %d timed, %.3f ns per cycle, %llu cycles of timing overhead taken out of each timed event):\n", (unsigned long long) counters.num_trials, PROFILE_SAMPLING_INTERVAL, nanoseconds_per_cycle, (unsigned long long) cycle_counter_overhead);
+    fprintf(output, "%-16s %14s %14s %14s %12s %7s\n", "stage", "events", "timed events", "cycles/event", "est. seconds", "share");
+    for (stage = 0; stage < NUM_PROFILE_STAGES; ++stage) {
+        fprintf(output, "%-16s %14llu %14llu %14.1f %12.6f %6.2f%%\n", profile_stage_names[stage], (unsigned long long) counters.num_events[stage], (unsigned long long) counters.num_timed_events[stage], counters.num_timed_events[stage] > 0 ? (double) counters.num_cycles[stage] / counters.num_timed_events[stage] : 0, estimated_num_cycles[stage] * nanoseconds_per_cycle * 1e-9, total_estimated_num_cycles > 0 ? estimated_num_cycles[stage] / total_estimated_num_cycles * 100 : 0);
+    }
+}
+
+void print_profile_report_at_exit() {
+    print_profile_report(stderr, profile_report_option);
+}
+
+// Starts a trial, which is timed once every PROFILE_SAMPLING_INTERVAL trials
+#define PROFILE_TRIAL() \
+    bool is_profiled_trial = (thread_profile_counters.num_trials++ & (PROFILE_SAMPLING_INTERVAL - 1)) == 0; \
+    uint64_t profile_cycle = is_profiled_trial == true ? read_cycle_counter() : 0
+
+// Ends a stage of the trial, which started where the previous one ended. The loops count the events afterwards.
+#define PROFILE_STAGE(stage) \
+    do { \
+        if (is_profiled_trial == true) { \
+            uint64_t cycle = read_cycle_counter(); \
+            thread_profile_counters.num_cycles[stage] += cycle - profile_cycle; \
+            ++(thread_profile_counters.num_timed_events[stage]); \
+            profile_cycle = cycle; \
+        } \
+    } while (0)
+
+#define PROFILE_EVENTS(stage, count) thread_profile_counters.num_events[stage] += count
+
+// Times a stage that runs once per simulation, on its own
+#define PROFILE_START() uint64_t profile_start = read_cycle_counter()
+#define PROFILE_END(stage) \
+    do { \
+        ++(thread_profile_counters.num_events[stage]); \
+        ++(thread_profile_counters.num_timed_events[stage]); \
+        thread_profile_counters.num_cycles[stage] += read_cycle_counter() - profile_start; \
+    } while (0)
+
+#define FLUSH_PROFILE_COUNTERS() flush_profile_counters()
+
+#else
+
+#define PROFILE_TRIAL()
+#define PROFILE_STAGE(stage)
+#define PROFILE_EVENTS(stage, count)
+#define PROFILE_START()
+#define PROFILE_END(stage)
+#define FLUSH_PROFILE_COUNTERS()
+
+#endif
+
+// #############################################
+// Simulations
+// #############################################
+
+#define DEPTH 1e5
+#define NUM_GAMES 1e0
+
+
+double get_time_in_seconds() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+
+// Trials are handed out to the workers in chunks; a worker that runs out of chunks steals half of another worker's remaining ones
+#define NUM_TRIALS_PER_CHUNK 1024
+#define MAX_NUM_THREADS 256
+
+#define CACHE_LINE_SIZE 64
+
+uint16_t num_threads = 1;
+
+// simulation methods:
+#define MONTE_CARLO 0
+#define EXACT_ENUMERATION 1
+#define AUTOMATIC_METHOD 2
+
+uint8_t simulation_method = AUTOMATIC_METHOD;
+
+// Sampling methods of the Monte Carlo trials, which are tallied in samples of a few trials each: the standard
+// errors follow from the spread of the samples' means, so that they reflect the variance the sampling saves.
+#define PLAIN_SAMPLING 0
+// every unseen card is in turn the first community card to deal, in samples of one trial per unseen card
+#define STRATIFIED_SAMPLING 1
+// every trial is followed by its mirror image, where each card is swapped for its mirror image among the unseen cards
+#define ANTITHETIC_SAMPLING 2
+
+uint8_t requested_sampling_method = PLAIN_SAMPLING;
+
+// With several shards, every simulation only runs the shard's share of the trials, in whole samples; the shards'
+// totals add up to the totals of the whole simulation when they are seeded alike
+uint32_t shard_index = 0;
+uint32_t num_shards = 1;
+
+// Relative costs of a hand evaluation and of drawing a random card, for choosing between the methods
+#define HAND_EVALUATION_COST 1.0
+#define RANDOM_CARD_DRAW_COST 0.4
+
+typedef struct {
+    double equities[MAX_NUM_PLAYERS];
+    // the part of the equities won in split pots
+    double tie_equities[MAX_NUM_PLAYERS];
+    double standard_errors[MAX_NUM_PLAYERS];
+    uint64_t num_trials;
+    uint8_t method;
+    bool is_cached;
+} WinningProbabilityDistribution;
+
+// The hero's (player 0's) equity at the tables made of the first num_players players of a game, at index num_players.
+// Every trial deals the whole game, so one simulation gives the equities at all the smaller tables.
+typedef struct {
+    double equities[MAX_NUM_PLAYERS + 1];
+    double tie_equities[MAX_NUM_PLAYERS + 1];
+    double standard_errors[MAX_NUM_PLAYERS + 1];
+    uint64_t num_trials;
+} EquityCurve;
+
+// A completed board and the players who win the pot on it, as a bit per player
+typedef struct {
+    CardMask community_cards;
+    uint32_t winners;
+} Runout;
+
+// The board completions enumerated so far for a game whose hole cards are all known, to be reused on the later streets
+typedef struct {
+    Runout* runouts;
+    uint64_t capacity;
+    uint64_t num_runouts;
+    // open addressing over the community cards, for looking the runouts up while enumerating a street
+    uint32_t* index;
+    uint32_t index_size;
+} RunoutTable;
+
+// The exact tallies of a simulation. Shares of the pot are counted in units of 1 / SHARE_DENOMINATOR, of which every
+// split of a pot between up to MAX_NUM_PLAYERS players is a whole number, so the tallies are integers: they add up to
+// the same totals in any order, whatever the threads or the shards the trials ran on.
+#define SHARE_DENOMINATOR 232792560 // lcm(1, 2, ..., MAX_NUM_PLAYERS)
+
+typedef struct {
+    uint64_t num_trials;
+    uint64_t num_samples;
+    uint16_t num_trials_per_sample;
+    uint8_t num_players;
+    // per player, the number of trials where they won the pot with num_winners - 1 other players, at num_winners - 1
+    uint64_t split_wins[MAX_NUM_PLAYERS][MAX_NUM_PLAYERS];
+    // per player, the sum of the squares of their shares summed over each sample
+    unsigned __int128 squared_sample_wins[MAX_NUM_PLAYERS];
+    // per player, the number of trials where their best hand was of each hand rank (a score's hand rank is
+    // score / HAND_RANK_WEIGHT), and the number of trials won with a hand of each hand rank
+    uint64_t hand_rank_counts[MAX_NUM_PLAYERS][NUM_HAND_RANKS];
+    uint64_t winning_hand_rank_counts[NUM_HAND_RANKS];
+} SimulationTotals;
+
+// Other hole cards for the hero (player 0), each played on the very same trials as the game's hero's. The unseen cards
+// they take are swapped for the ones the game's hero frees up, so every trial is still a uniform deal for them, and
+// the differences between the equities come out with far less noise than from separate simulations.
+#define MAX_NUM_ALTERNATIVE_HEROES 16
+
+typedef struct {
+    CardMask hole_cards[MAX_NUM_ALTERNATIVE_HEROES];
+    uint8_t count;
+    double equities[MAX_NUM_ALTERNATIVE_HEROES];
+    double standard_errors[MAX_NUM_ALTERNATIVE_HEROES];
+    // of the difference with the game's hero's equity, from the paired trials and as if the simulations were separate
+    double difference_standard_errors[MAX_NUM_ALTERNATIVE_HEROES];
+    double independent_difference_standard_errors[MAX_NUM_ALTERNATIVE_HEROES];
+} HeroComparison;
+
+// Monte Carlo runs stop once every player's standard error is at most the target (0 runs max_num_trials),
+// or once max_num_trials or max_num_seconds (0 for no limit) is reached
+typedef struct {
+    double target_standard_error;
+    uint64_t max_num_trials;
+    double max_num_seconds;
+} StoppingRule;
+
+StoppingRule init_stopping_rule() {
+    StoppingRule res;
+    res.target_standard_error = 0;
+    res.max_num_trials = DEPTH;
+    res.max_num_seconds = 0;
+    return res;
+}
+
+StoppingRule stopping_rule_option;
+
+// Trials run before the first convergence check, so that the variances are meaningful
+#define MIN_NUM_TRIALS_BEFORE_STOPPING 4096
+
+typedef struct {
+    pthread_mutex_t lock;
+    uint64_t next_chunk;
+    uint64_t end_chunk;
+} ChunkQueue;
+
+// Everything a worker's trials write, set up once per simulation and reused in place by every trial: the fields
+// are ordered by decreasing size, so that there's no padding between them, and the block starts a cache line
+typedef struct {
+    CardMask players_hole_cards[MAX_NUM_PLAYERS];
+    double players_equities[MAX_NUM_PLAYERS];
+    // the players' shares summed over the trials of the current sample, in units of 1 / SHARE_DENOMINATOR
+    uint64_t sample_wins[MAX_NUM_PLAYERS];
+    uint32_t players_strongest_hands[MAX_NUM_PLAYERS];
+    uint16_t players_combinations[MAX_NUM_PLAYERS];
+    // the unseen cards as card indices (suit * 13 + rank), drawn by moving them to the front
+    uint8_t unseen_card_indices[STANDARD_DECK_SIZE];
+    // the unseen cards in order, one stratum each when sampling is stratified
+    uint8_t stratum_card_indices[STANDARD_DECK_SIZE];
+    // each unseen card's mirror image, by card index, when sampling is antithetic
+    uint8_t antithetic_card_indices[STANDARD_DECK_SIZE];
+    uint8_t num_unseen_cards;
+} __attribute__((aligned(CACHE_LINE_SIZE))) TrialScratch;
+
+// Workers are allocated aligned to cache lines, and their size is a multiple of it, so they never share one
+typedef struct {
+    TrialScratch scratch;
+    Game* game;
+    uint8_t method;
+    uint8_t sampling_method;
+    uint16_t num_trials_per_sample;
+    uint16_t num_trials_in_sample;
+    // chunks are whole samples
+    uint64_t num_trials_per_chunk;
+    uint64_t first_trial;
+    uint64_t end_trial;
+    double deadline;
+    ChunkQueue* chunk_queues;
+    uint16_t num_workers;
+    uint16_t index;
+    RandomNumberGenerator random_number_generator;
+    // reproducible workers deal every trial from the unseen cards in order, with the numbers of the trial's part of
+    // the seed's SplitMix64 sequence
+    bool is_reproducible;
+    uint64_t seed;
+    SimulationTotals totals;
+    // per player and hole cards combination, for the players with ranges (NULL without any)
+    double* range_combination_equities;
+    uint64_t* range_combination_num_trials;
+    // the hero's tallies at each smaller table, when simulating an equity curve
+    bool is_equity_curve_tallied;
+    double equity_curve_wins[MAX_NUM_PLAYERS + 1];
+    double equity_curve_tied_wins[MAX_NUM_PLAYERS + 1];
+    double equity_curve_squared_wins[MAX_NUM_PLAYERS + 1];
+    // the alternative heroes' tallies, and their differences with the game's hero's (NULL without a comparison)
+    HeroComparison* hero_comparison;
+    double hero_comparison_wins[MAX_NUM_ALTERNATIVE_HEROES];
+    double hero_comparison_squared_wins[MAX_NUM_ALTERNATIVE_HEROES];
+    double hero_comparison_differences[MAX_NUM_ALTERNATIVE_HEROES];
+    double hero_comparison_squared_differences[MAX_NUM_ALTERNATIVE_HEROES];
+    uint64_t num_trials_run;
+    // shared by the workers: set once a trial's ranges can't be dealt together, which stops them all
+    bool* has_failed;
+} SimulationWorker;
+
+// The random numbers of a reproducible trial; a trial never comes close to using them all
+#define NUM_RANDOM_NUMBERS_PER_TRIAL (1 << 16)
+
+void init_trial_scratch(TrialScratch* scratch, Game* game, Deck* unseen_cards) {
+    memset(scratch, 0, sizeof(TrialScratch));
+    for (uint8_t i = 0; i < game->players.count; ++i) {
+        scratch->players_hole_cards[i] = game->players.hole_cards[i].mask;
+    }
+    for (uint8_t i = 0; i < unseen_cards->count; ++i) {
+        scratch->unseen_card_indices[i] = get_card_index(&unseen_cards->cards[i]);
+        scratch->stratum_card_indices[i] = scratch->unseen_card_indices[i];
+    }
+    scratch->num_unseen_cards = unseen_cards->count;
+    // the j-th lowest unseen card and the j-th highest one are each other's mirror image: as the card indices go by suit
+    // then by rank, low cards and high cards swap, and so do the suits, so neither a flush nor a straight carries over
+    for (uint8_t i = 0; i < unseen_cards->count; ++i) {
+        scratch->antithetic_card_indices[scratch->stratum_card_indices[i]] = scratch->stratum_card_indices[unseen_cards->count - 1 - i];
+    }
+}
+
+// The requested sampling, where it keeps every trial a uniform deal: the range hole cards aren't drawn from the unseen
+// cards, stratification needs a community card to deal, and the comparisons' and the equity curve's standard errors
+// assume plain sampling
+uint8_t choose_sampling_method(Game* game, uint8_t method, EquityCurve* equity_curve, HeroComparison* hero_comparison) {
+    if (method != MONTE_CARLO || get_num_players_with_ranges(&game->players) > 0 || equity_curve != NULL || hero_comparison != NULL) {
+        return PLAIN_SAMPLING;
+    }
+    if (requested_sampling_method == STRATIFIED_SAMPLING && game->community_cards.count == MAX_NUM_COMMUNITY_CARDS) {
+        return PLAIN_SAMPLING;
+    }
+    return requested_sampling_method;
+}
+
+uint16_t get_num_trials_per_sample(uint8_t sampling_method, uint8_t num_unseen_cards) {
+    if (sampling_method == STRATIFIED_SAMPLING) {
+        return num_unseen_cards;
+    }
+    if (sampling_method == ANTITHETIC_SAMPLING) {
+        return 2;
+    }
+    return 1;
+}
+
+// Players whose hole cards are unknown get theirs dealt from the unseen cards in every trial
+uint8_t get_num_players_with_unknown_hole_cards(Players* players) {
+    uint8_t res = 0;
+    for (uint8_t i = 0; i < players->count; ++i) {
+        if (players->hole_cards[i].count == 0) {
+            ++res;
+        }
+    }
+    return res;
+}
+
+void init_simulation_totals(SimulationTotals* totals, uint8_t num_players, uint16_t num_trials_per_sample) {
+    memset(totals, 0, sizeof(SimulationTotals));
+    totals->num_players = num_players;
+    totals->num_trials_per_sample = num_trials_per_sample;
+}
+
+void add_simulation_totals(SimulationTotals* totals, SimulationTotals* other_totals) {
+    totals->num_trials += other_totals->num_trials;
+    totals->num_samples += other_totals->num_samples;
+    for (uint8_t i = 0; i < totals->num_players; ++i) {
+        for (uint8_t j = 0; j < totals->num_players; ++j) {
+            totals->split_wins[i][j] += other_totals->split_wins[i][j];
+        }
+        totals->squared_sample_wins[i] += other_totals->squared_sample_wins[i];
+        for (uint8_t hand_rank = NOTHING; hand_rank < NUM_HAND_RANKS; ++hand_rank) {
+            totals->hand_rank_counts[i][hand_rank] += other_totals->hand_rank_counts[i][hand_rank];
+        }
+    }
+    for (uint8_t hand_rank = NOTHING; hand_rank < NUM_HAND_RANKS; ++hand_rank) {
+        totals->winning_hand_rank_counts[hand_rank] += other_totals->winning_hand_rank_counts[hand_rank];
+    }
+}
+
+// Only the winners of the trial have anything to tally
+void tally_trial(SimulationWorker* worker, double* players_equities, uint8_t num_players) {
+    SimulationTotals* totals = &worker->totals;
+    uint64_t* sample_wins = worker->scratch.sample_wins;
+    for (uint8_t i = 0; i < num_players; ++i) {
+        if (players_equities[i] > 0) {
+            uint8_t num_winners = 1 / players_equities[i] + 0.5;
+            ++(totals->split_wins[i][num_winners - 1]);
+            sample_wins[i] += SHARE_DENOMINATOR / num_winners;
+        }
+    }
+    ++(totals->num_trials);
+    if (++(worker->num_trials_in_sample) == worker->num_trials_per_sample) {
+        for (uint8_t i = 0; i < num_players; ++i) {
+            if (sample_wins[i] > 0) {
+                totals->squared_sample_wins[i] += (unsigned __int128) sample_wins[i] * sample_wins[i];
+                sample_wins[i] = 0;
+            }
+        }
+        worker->num_trials_in_sample = 0;
+        ++(totals->num_samples);
+    }
+}
+
+// The scores already hold the hand ranks, so the trial's hand rank counts come for a division by a constant each
+void tally_hand_ranks(SimulationTotals* totals, uint32_t* players_strongest_hands, uint8_t num_players) {
+    uint32_t strongest_hand = 0;
+    for (uint8_t i = 0; i < num_players; ++i) {
+        ++(totals->hand_rank_counts[i][players_strongest_hands[i] / HAND_RANK_WEIGHT]);
+        if (players_strongest_hands[i] > strongest_hand) {
+            strongest_hand = players_strongest_hands[i];
+        }
+    }
+    ++(totals->winning_hand_rank_counts[strongest_hand / HAND_RANK_WEIGHT]);
+}
+
+// The cards of mask among from_cards, replaced by the cards of to_cards of the same order
+CardMask exchange_cards(CardMask mask, CardMask from_cards, CardMask to_cards) {
+    CardMask res = mask & ~from_cards;
+    while (from_cards != 0) {
+        CardMask from_card = from_cards & -from_cards;
+        CardMask to_card = to_cards & -to_cards;
+        if ((mask & from_card) != 0) {
+            res |= to_card;
+        }
+        from_cards ^= from_card;
+        to_cards ^= to_card;
+    }
+    return res;
+}
+
+// Plays each alternative hero on the trial just run. Its cards that were dealt to the board or to the opponents are
+// exchanged for the game's hero's ones, and only then do the opponents' hands need evaluating again.
+void tally_hero_comparison(SimulationWorker* worker, CardMask community_cards) {
+    Game* game = worker->game;
+    TrialScratch* scratch = &worker->scratch;
+    HeroComparison* hero_comparison = worker->hero_comparison;
+    CardMask hero_hole_cards = scratch->players_hole_cards[0];
+    CardMask dealt_cards = community_cards;
+    for (uint8_t i = 1; i < game->players.count; ++i) {
+        dealt_cards |= scratch->players_hole_cards[i];
+    }
+    CardMask players_hole_cards[MAX_NUM_PLAYERS];
+    uint32_t players_strongest_hands[MAX_NUM_PLAYERS];
+    double players_equities[MAX_NUM_PLAYERS];
+    for (uint8_t j = 0; j < hero_comparison->count; ++j) {
+        CardMask taken_cards = hero_comparison->hole_cards[j] & ~hero_hole_cards;
+        CardMask freed_cards = hero_hole_cards & ~hero_comparison->hole_cards[j];
+        if ((dealt_cards & taken_cards) == 0) {
+            memcpy(players_strongest_hands, scratch->players_strongest_hands, game->players.count * sizeof(uint32_t));
+            set_players_strongest_hands(players_strongest_hands, &hero_comparison->hole_cards[j], 1, community_cards);
+        }
+        else {
+            players_hole_cards[0] = hero_comparison->hole_cards[j];
+            for (uint8_t i = 1; i < game->players.count; ++i) {
+                players_hole_cards[i] = exchange_cards(scratch->players_hole_cards[i], taken_cards, freed_cards);
+            }
+            set_players_strongest_hands(players_strongest_hands, players_hole_cards, game->players.count, exchange_cards(community_cards, taken_cards, freed_cards));
+        }
+        set_players_equities_from_strongest_hands(players_equities, players_strongest_hands, game->players.count);
+
+        double difference = players_equities[0] - scratch->players_equities[0];
+        worker->hero_comparison_wins[j] += players_equities[0];
+        worker->hero_comparison_squared_wins[j] += players_equities[0] * players_equities[0];
+        worker->hero_comparison_differences[j] += difference;
+        worker->hero_comparison_squared_differences[j] += difference * difference;
+    }
+}
+
+// The hero's share of the pot at each table of the first num_players players follows from the players' hands
+// in one pass: the hero loses as soon as a player beats them, and splits the pot with the players who tie.
+void tally_equity_curve(SimulationWorker* worker, uint32_t* players_strongest_hands, uint8_t num_players) {
+    uint8_t num_tied_players = 1;
+    for (uint8_t i = 1; i < num_players; ++i) {
+        if (players_strongest_hands[i] > players_strongest_hands[0]) {
+            return;
+        }
+        if (players_strongest_hands[i] == players_strongest_hands[0]) {
+            ++num_tied_players;
+        }
+        double equity = (double) 1 / num_tied_players;
+        worker->equity_curve_wins[i + 1] += equity;
+        worker->equity_curve_squared_wins[i + 1] += equity * equity;
+        if (num_tied_players > 1) {
+            worker->equity_curve_tied_wins[i + 1] += equity;
+        }
+    }
+}
+
+uint32_t get_winners(double* players_equities, uint8_t num_players) {
+    uint32_t res = 0;
+    for (uint8_t i = 0; i < num_players; ++i) {
+        if (players_equities[i] > 0) {
+            res |= 1 << i;
+        }
+    }
+    return res;
+}
+
+void tally_range_combinations(SimulationWorker* worker, double* players_equities, uint16_t* players_combinations) {
+    Players* players = &worker->game->players;
+    for (uint8_t i = 0; i < players->count; ++i) {
+        if (players->ranges[i] != NULL && players->hole_cards[i].count == 0) {
+            uint32_t index = i * NUM_HOLE_CARDS_COMBINATIONS + players_combinations[i];
+            worker->range_combination_equities[index] += players_equities[i];
+            ++(worker->range_combination_num_trials[index]);
+        }
+    }
+}
+
+void run_monte_carlo_trials(SimulationWorker* worker, uint64_t first_trial, uint64_t num_trials) {
+    Game* game = worker->game;
+    TrialScratch* scratch = &worker->scratch;
+    // The burned cards are unseen and never used, so only the missing community cards and hole cards need to be drawn
+    uint8_t num_community_cards_to_deal = MAX_NUM_COMMUNITY_CARDS - game->community_cards.count;
+    uint8_t num_players_with_ranges = get_num_players_with_ranges(&game->players);
+    uint8_t num_hole_cards_to_deal = (get_num_players_with_unknown_hole_cards(&game->players) - num_players_with_ranges) * NUM_HOLE_CARDS_PER_PLAYER;
+    uint8_t num_cards_to_draw = num_hole_cards_to_deal + num_community_cards_to_deal;
+    BoardState fixed_board_state = get_board_state(game->community_cards.mask);
+    for (uint64_t iters = 0; iters < num_trials; ++iters) {
+        PROFILE_TRIAL();
+
+        if (worker->is_reproducible == true) {
+            // the mirror image of an antithetic sample's first trial is dealt with that trial's numbers
+            uint64_t trial = first_trial + iters;
+            if (worker->sampling_method == ANTITHETIC_SAMPLING) {
+                trial -= worker->num_trials_in_sample;
+            }
+            memcpy(scratch->unseen_card_indices, scratch->stratum_card_indices, scratch->num_unseen_cards);
+            seek_splitmix64(&worker->random_number_generator, worker->seed, trial * NUM_RANDOM_NUMBERS_PER_TRIAL);
+        }
+        CardMask drawn_cards;
+        if (num_players_with_ranges > 0) {
+            CardMask range_hole_cards;
+            if (draw_hole_cards_from_ranges(&game->players, scratch->players_hole_cards, scratch->players_combinations, &range_hole_cards, &worker->random_number_generator) == false) {
+                __atomic_store_n(worker->has_failed, true, __ATOMIC_RELAXED);
+                worker->num_trials_run += iters;
+                return;
+            }
+            drawn_cards = draw_random_card_indices_excluding(scratch->unseen_card_indices, scratch->num_unseen_cards, num_cards_to_draw, range_hole_cards, &worker->random_number_generator);
+        }
+        else if (worker->sampling_method == STRATIFIED_SAMPLING) {
+            // the stratum's card is the first community card, after the hole cards drawn from the other cards
+            CardMask stratum_card = (CardMask) 1 << scratch->stratum_card_indices[worker->num_trials_in_sample];
+            drawn_cards = stratum_card | draw_random_card_indices_excluding(scratch->unseen_card_indices, scratch->num_unseen_cards, num_cards_to_draw - 1, stratum_card, &worker->random_number_generator);
+        }
+        else if (worker->sampling_method == ANTITHETIC_SAMPLING && worker->num_trials_in_sample == 1) {
+            if (worker->is_reproducible == true) {
+                // the deck is back in order, so the sample's first trial is dealt again
+                draw_random_card_indices(scratch->unseen_card_indices, scratch->num_unseen_cards, num_cards_to_draw, &worker->random_number_generator);
+            }
+            // the whole deck is mirrored, which keeps it a permutation of the unseen cards, and the previous trial's
+            // cards at its front become their mirror images
+            drawn_cards = 0;
+            for (uint8_t i = 0; i < scratch->num_unseen_cards; ++i) {
+                scratch->unseen_card_indices[i] = scratch->antithetic_card_indices[scratch->unseen_card_indices[i]];
+            }
+            for (uint8_t i = 0; i < num_cards_to_draw; ++i) {
+                drawn_cards |= (CardMask) 1 << scratch->unseen_card_indices[i];
+            }
+        }
+        else {
+            drawn_cards = draw_random_card_indices(scratch->unseen_card_indices, scratch->num_unseen_cards, num_cards_to_draw, &worker->random_number_generator);
+        }
+        PROFILE_STAGE(DRAW_CARDS_STAGE);
+        if (num_hole_cards_to_deal > 0) {
+            // the drawn cards are at the front of the deck, and the first ones go to the players
+            uint8_t* hole_card_indices = scratch->unseen_card_indices;
+            for (uint8_t i = 0; i < game->players.count; ++i) {
+                if (game->players.hole_cards[i].count == 0 && game->players.ranges[i] == NULL) {
+                    scratch->players_hole_cards[i] = ((CardMask) 1 << hole_card_indices[0]) | ((CardMask) 1 << hole_card_indices[1]);
+                    drawn_cards &= ~scratch->players_hole_cards[i];
+                    hole_card_indices += NUM_HOLE_CARDS_PER_PLAYER;
+                }
+            }
+        }
+        CardMask community_cards = game->community_cards.mask | drawn_cards;
+        PROFILE_STAGE(DEAL_HOLE_CARDS_STAGE);
+
+        set_players_strongest_hands_on_dealt_board(scratch->players_strongest_hands, scratch->players_hole_cards, game->players.count, &fixed_board_state, game->community_cards.mask, drawn_cards);
+        PROFILE_STAGE(EVALUATE_STAGE);
+        set_players_equities_from_strongest_hands(scratch->players_equities, scratch->players_strongest_hands, game->players.count);
+        PROFILE_STAGE(SETTLE_POT_STAGE);
+
+        if (worker->hero_comparison != NULL) {
+            tally_hero_comparison(worker, community_cards);
+        }
+        tally_trial(worker, scratch->players_equities, game->players.count);
+        tally_hand_ranks(&worker->totals, scratch->players_strongest_hands, game->players.count);
+        if (worker->is_equity_curve_tallied == true) {
+            tally_equity_curve(worker, scratch->players_strongest_hands, game->players.count);
+        }
+        if (num_players_with_ranges > 0) {
+            tally_range_combinations(worker, scratch->players_equities, scratch->players_combinations);
+        }
+        PROFILE_STAGE(TALLY_STAGE);
+    }
+    PROFILE_EVENTS(DRAW_CARDS_STAGE, num_trials);
+    PROFILE_EVENTS(DEAL_HOLE_CARDS_STAGE, num_trials);
+    PROFILE_EVENTS(EVALUATE_STAGE, num_trials);
+    PROFILE_EVENTS(SETTLE_POT_STAGE, num_trials);
+    PROFILE_EVENTS(TALLY_STAGE, num_trials);
+    worker->num_trials_run += num_trials;
+}
+
+// Sets the (increasing) unseen card indices of the combination with the given colexicographic rank
+void unrank_combination(uint64_t rank, uint8_t num_cards, uint8_t* card_indices) {
+    for (int8_t i = num_cards - 1; i >= 0; --i) {
+        uint8_t card_index = i;
+        while (binomial_coefficients[card_index + 1][i + 1] <= rank) {
+            ++card_index;
+        }
+        card_indices[i] = card_index;
+        rank -= binomial_coefficients[card_index][i + 1];
+    }
+}
+
+void advance_combination(uint8_t num_cards, uint8_t* card_indices) {
+    uint8_t i = 0;
+    while (i + 1 < num_cards && card_indices[i] + 1 == card_indices[i + 1]) {
+        card_indices[i] = i;
+        ++i;
+    }
+    ++(card_indices[i]);
+}
+
+// Each trial is one completion of the board: the unseen card combination whose rank is the trial index.
+// Every completion is equally likely whatever the burned cards were, so they are simply left unseen.
+void run_exact_enumeration_trials(SimulationWorker* worker, uint64_t first_trial, uint64_t num_trials) {
+    Game* game = worker->game;
+    TrialScratch* scratch = &worker->scratch;
+    uint8_t num_community_cards_to_deal = MAX_NUM_COMMUNITY_CARDS - game->community_cards.count;
+    uint8_t card_indices[MAX_NUM_COMMUNITY_CARDS];
+    unrank_combination(first_trial, num_community_cards_to_deal, card_indices);
+    BoardState fixed_board_state = get_board_state(game->community_cards.mask);
+    for (uint64_t iters = 0; iters < num_trials; ++iters) {
+        PROFILE_TRIAL();
+
+        CardMask dealt_cards = 0;
+        for (uint8_t i = 0; i < num_community_cards_to_deal; ++i) {
+            dealt_cards |= (CardMask) 1 << scratch->unseen_card_indices[card_indices[i]];
+        }
+        CardMask community_cards = game->community_cards.mask | dealt_cards;
+        PROFILE_STAGE(DRAW_CARDS_STAGE);
+
+        set_players_strongest_hands_on_dealt_board(scratch->players_strongest_hands, scratch->players_hole_cards, game->players.count, &fixed_board_state, game->community_cards.mask, dealt_cards);
+        PROFILE_STAGE(EVALUATE_STAGE);
+        set_players_equities_from_strongest_hands(scratch->players_equities, scratch->players_strongest_hands, game->players.count);
+        PROFILE_STAGE(SETTLE_POT_STAGE);
+
+        if (worker->hero_comparison != NULL) {
+            tally_hero_comparison(worker, community_cards);
+        }
+        tally_trial(worker, scratch->players_equities, game->players.count);
+        tally_hand_ranks(&worker->totals, scratch->players_strongest_hands, game->players.count);
+        if (worker->is_equity_curve_tallied == true) {
+            tally_equity_curve(worker, scratch->players_strongest_hands, game->players.count);
+        }
+
+        if (num_community_cards_to_deal > 0) {
+            advance_combination(num_community_cards_to_deal, card_indices);
+        }
+        PROFILE_STAGE(TALLY_STAGE);
+    }
+    PROFILE_EVENTS(DRAW_CARDS_STAGE, num_trials);
+    PROFILE_EVENTS(EVALUATE_STAGE, num_trials);
+    PROFILE_EVENTS(SETTLE_POT_STAGE, num_trials);
+    PROFILE_EVENTS(TALLY_STAGE, num_trials);
+    worker->num_trials_run += num_trials;
+}
+
+void run_trials(SimulationWorker* worker, uint64_t first_trial, uint64_t num_trials) {
+    if (worker->method == EXACT_ENUMERATION) {
+        run_exact_enumeration_trials(worker, first_trial, num_trials);
+    }
+    else {
+        run_monte_carlo_trials(worker, first_trial, num_trials);
+    }
+}
+
+bool take_chunk_from_queue(ChunkQueue* queue, uint64_t* chunk) {
+    bool res = false;
+    pthread_mutex_lock(&queue->lock);
+    if (queue->next_chunk < queue->end_chunk) {
+        *chunk = (queue->next_chunk)++;
+        res = true;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return res;
+}
+
+// Moves the back half of another worker's remaining chunks into the worker's own (empty) queue
+bool steal_chunks(SimulationWorker* worker) {
+    ChunkQueue* own_queue = &worker->chunk_queues[worker->index];
+    for (uint16_t offset = 1; offset < worker->num_workers; ++offset) {
+        ChunkQueue* victim_queue = &worker->chunk_queues[(worker->index + offset) % worker->num_workers];
+        pthread_mutex_lock(&victim_queue->lock);
+        uint64_t num_remaining_chunks = victim_queue->end_chunk - victim_queue->next_chunk;
+        if (num_remaining_chunks == 0) {
+            pthread_mutex_unlock(&victim_queue->lock);
+            continue;
+        }
+        uint64_t end_chunk = victim_queue->end_chunk;
+        victim_queue->end_chunk -= (num_remaining_chunks + 1) / 2;
+        uint64_t next_chunk = victim_queue->end_chunk;
+        pthread_mutex_unlock(&victim_queue->lock);
+
+        pthread_mutex_lock(&own_queue->lock);
+        own_queue->next_chunk = next_chunk;
+        own_queue->end_chunk = end_chunk;
+        pthread_mutex_unlock(&own_queue->lock);
+        return true;
+    }
+    return false;
+}
+
+void* run_simulation_worker(void* arg) {
+    SimulationWorker* worker = arg;
+    uint64_t chunk;
+    do {
+        while (take_chunk_from_queue(&worker->chunk_queues[worker->index], &chunk) == true) {
+            uint64_t first_trial = worker->first_trial + chunk * worker->num_trials_per_chunk;
+            uint64_t last_trial = first_trial + worker->num_trials_per_chunk;
+            if (last_trial > worker->end_trial) {
+                last_trial = worker->end_trial;
+            }
+            run_trials(worker, first_trial, last_trial - first_trial);
+            if (__atomic_load_n(worker->has_failed, __ATOMIC_RELAXED) == true || (worker->deadline > 0 && get_time_in_seconds() > worker->deadline)) {
+                FLUSH_PROFILE_COUNTERS();
+                return NULL;
+            }
+        }
+    } while (steal_chunks(worker) == true);
+    FLUSH_PROFILE_COUNTERS();
+    return NULL;
+}
+
+// Runs trials [first_trial, first_trial + num_trials) on the workers, adding to their tallies. Both ends are whole samples.
+void run_simulation_round(SimulationWorker* workers, ChunkQueue* chunk_queues, uint16_t num_workers, uint64_t first_trial, uint64_t num_trials) {
+    pthread_t threads[MAX_NUM_THREADS];
+    uint64_t num_chunks = (num_trials + workers[0].num_trials_per_chunk - 1) / workers[0].num_trials_per_chunk;
+    uint16_t i;
+    for (i = 0; i < num_workers; ++i) {
+        chunk_queues[i].next_chunk = num_chunks * i / num_workers;
+        chunk_queues[i].end_chunk = num_chunks * (i + 1) / num_workers;
+        workers[i].first_trial = first_trial;
+        workers[i].end_trial = first_trial + num_trials;
+    }
+
+    // The calling thread is worker 0
+    for (i = 1; i < num_workers; ++i) {
+        pthread_create(&threads[i], NULL, run_simulation_worker, &workers[i]);
+    }
+    run_simulation_worker(&workers[0]);
+    for (i = 1; i < num_workers; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+}
+
+// The standard errors follow from the spread of the samples' mean shares, which are the trials' ones with plain sampling
+void set_winning_probability_distribution_from_totals(WinningProbabilityDistribution* winning_probability_distribution, SimulationTotals* totals) {
+    double sample_share_denominator = (double) totals->num_trials_per_sample * SHARE_DENOMINATOR;
+    for (uint8_t i = 0; i < totals->num_players; ++i) {
+        unsigned __int128 wins = 0;
+        unsigned __int128 tied_wins = 0;
+        for (uint8_t num_winners = 1; num_winners <= totals->num_players; ++num_winners) {
+            unsigned __int128 split_wins = (unsigned __int128) totals->split_wins[i][num_winners - 1] * (SHARE_DENOMINATOR / num_winners);
+            wins += split_wins;
+            if (num_winners > 1) {
+                tied_wins += split_wins;
+            }
+        }
+        winning_probability_distribution->equities[i] = 0;
+        winning_probability_distribution->tie_equities[i] = 0;
+        winning_probability_distribution->standard_errors[i] = 0;
+        if (totals->num_trials == 0) {
+            continue;
+        }
+        // the samples are complete, so the mean of their means is the mean of the trials
+        double mean = (double) wins / SHARE_DENOMINATOR / totals->num_trials;
+        winning_probability_distribution->equities[i] = mean;
+        winning_probability_distribution->tie_equities[i] = (double) tied_wins / SHARE_DENOMINATOR / totals->num_trials;
+        if (totals->num_samples > 1) {
+            double squared_sample_means = (double) totals->squared_sample_wins[i] / sample_share_denominator / sample_share_denominator;
+            double variance = (squared_sample_means - totals->num_samples * mean * mean) / (totals->num_samples - 1);
+            if (variance > 0) {
+                winning_probability_distribution->standard_errors[i] = sqrt(variance / totals->num_samples);
+            }
+        }
+    }
+    winning_probability_distribution->num_trials = totals->num_trials;
+}
+
+// Merges the workers' tallies into totals, and those into equities and standard errors
+void set_winning_probability_distribution_from_workers(WinningProbabilityDistribution* winning_probability_distribution, SimulationTotals* totals, SimulationWorker* workers, uint16_t num_workers, uint8_t num_players) {
+    PROFILE_START();
+    init_simulation_totals(totals, num_players, workers[0].num_trials_per_sample);
+    for (uint16_t i = 0; i < num_workers; ++i) {
+        add_simulation_totals(totals, &workers[i].totals);
+    }
+    set_winning_probability_distribution_from_totals(winning_probability_distribution, totals);
+    PROFILE_END(MERGE_STAGE);
+}
+
+// The game's hero's standard error comes from winning_probability_distribution, already merged
+void set_hero_comparison_from_workers(HeroComparison* hero_comparison, WinningProbabilityDistribution* winning_probability_distribution, SimulationWorker* workers, uint16_t num_workers) {
+    uint64_t iters = 0;
+    uint16_t i;
+    for (i = 0; i < num_workers; ++i) {
+        iters += workers[i].num_trials_run;
+    }
+    for (uint8_t j = 0; j < hero_comparison->count; ++j) {
+        double wins = 0;
+        double squared_wins = 0;
+        double differences = 0;
+        double squared_differences = 0;
+        for (i = 0; i < num_workers; ++i) {
+            wins += workers[i].hero_comparison_wins[j];
+            squared_wins += workers[i].hero_comparison_squared_wins[j];
+            differences += workers[i].hero_comparison_differences[j];
+            squared_differences += workers[i].hero_comparison_squared_differences[j];
+        }
+        double mean = wins / iters;
+        double mean_difference = differences / iters;
+        hero_comparison->equities[j] = mean;
+        hero_comparison->standard_errors[j] = 0;
+        hero_comparison->difference_standard_errors[j] = 0;
+        if (iters > 1) {
+            double variance = (squared_wins - iters * mean * mean) / (iters - 1);
+            if (variance > 0) {
+                hero_comparison->standard_errors[j] = sqrt(variance / iters);
+            }
+            variance = (squared_differences - iters * mean_difference * mean_difference) / (iters - 1);
+            if (variance > 0) {
+                hero_comparison->difference_standard_errors[j] = sqrt(variance / iters);
+            }
+        }
+        double hero_standard_error = winning_probability_distribution->standard_errors[0];
+        hero_comparison->independent_difference_standard_errors[j] = sqrt(hero_standard_error * hero_standard_error + hero_comparison->standard_errors[j] * hero_comparison->standard_errors[j]);
+    }
+}
+
+// The table of the hero alone is left out (index 0 and 1 stay 0)
+void set_equity_curve_from_workers(EquityCurve* equity_curve, SimulationWorker* workers, uint16_t num_workers, uint8_t num_players) {
+    uint64_t iters = 0;
+    uint16_t i;
+    for (i = 0; i < num_workers; ++i) {
+        iters += workers[i].num_trials_run;
+    }
+    for (uint8_t j = 0; j <= MAX_NUM_PLAYERS; ++j) {
+        equity_curve->equities[j] = 0;
+        equity_curve->tie_equities[j] = 0;
+        equity_curve->standard_errors[j] = 0;
+        if (j < MIN_NUM_PLAYERS || j > num_players) {
+            continue;
+        }
+        double wins = 0;
+        double tied_wins = 0;
+        double squared_wins = 0;
+        for (i = 0; i < num_workers; ++i) {
+            wins += workers[i].equity_curve_wins[j];
+            tied_wins += workers[i].equity_curve_tied_wins[j];
+            squared_wins += workers[i].equity_curve_squared_wins[j];
+        }
+        double mean = wins / iters;
+        equity_curve->equities[j] = mean;
+        equity_curve->tie_equities[j] = tied_wins / iters;
+        if (iters > 1) {
+            double variance = (squared_wins - iters * mean * mean) / (iters - 1);
+            if (variance > 0) {
+                equity_curve->standard_errors[j] = sqrt(variance / iters);
+            }
+        }
+    }
+    equity_curve->num_trials = iters;
+}
+
+void set_range_combination_equities_from_workers(Players* players, SimulationWorker* workers, uint16_t num_workers) {
+    for (uint8_t i = 0; i < players->count; ++i) {
+        Range* range = players->ranges[i];
+        if (range == NULL || players->hole_cards[i].count > 0) {
+            continue;
+        }
+        for (uint16_t combination = 0; combination < NUM_HOLE_CARDS_COMBINATIONS; ++combination) {
+            double equities = 0;
+            uint64_t num_trials = 0;
+            for (uint16_t j = 0; j < num_workers; ++j) {
+                equities += workers[j].range_combination_equities[i * NUM_HOLE_CARDS_COMBINATIONS + combination];
+                num_trials += workers[j].range_combination_num_trials[i * NUM_HOLE_CARDS_COMBINATIONS + combination];
+            }
+            range->combination_equities[combination] = num_trials > 0 ? equities / num_trials : 0;
+            range->combination_num_trials[combination] = num_trials;
+        }
+    }
+}
+
+double get_max_standard_error(WinningProbabilityDistribution* winning_probability_distribution, uint8_t num_players) {
+    double res = 0;
+    for (uint8_t i = 0; i < num_players; ++i) {
+        if (winning_probability_distribution->standard_errors[i] > res) {
+            res = winning_probability_distribution->standard_errors[i];
+        }
+    }
+    return res;
+}
+
+double get_max_standard_error_of_equity_curve(EquityCurve* equity_curve) {
+    double res = 0;
+    for (uint8_t i = MIN_NUM_PLAYERS; i <= MAX_NUM_PLAYERS; ++i) {
+        if (equity_curve->standard_errors[i] > res) {
+            res = equity_curve->standard_errors[i];
+        }
+    }
+    return res;
+}
+
+// Enumerates the board completions when that costs no more than the Monte Carlo trial budget
+uint8_t choose_simulation_method(Game* game, uint8_t num_unseen_cards, StoppingRule* stopping_rule) {
+    // Only the board completions are enumerated, so unknown hole cards need Monte Carlo
+    if (get_num_players_with_unknown_hole_cards(&game->players) > 0) {
+        return MONTE_CARLO;
+    }
+    if (simulation_method != AUTOMATIC_METHOD) {
+        return simulation_method;
+    }
+    uint8_t num_community_cards_to_deal = MAX_NUM_COMMUNITY_CARDS - game->community_cards.count;
+    double exact_enumeration_cost = binomial_coefficients[num_unseen_cards][num_community_cards_to_deal] * game->players.count * HAND_EVALUATION_COST;
+    double num_monte_carlo_trials = stopping_rule->max_num_trials;
+    if (stopping_rule->target_standard_error > 0) {
+        // a player's share of the pot is in [0, 1], so its variance is at most 1/4
+        double max_num_trials_needed = 0.25 / (stopping_rule->target_standard_error * stopping_rule->target_standard_error);
+        if (max_num_trials_needed < num_monte_carlo_trials) {
+            num_monte_carlo_trials = max_num_trials_needed;
+        }
+    }
+    double monte_carlo_cost = num_monte_carlo_trials * (game->players.count * HAND_EVALUATION_COST + num_community_cards_to_deal * RANDOM_CARD_DRAW_COST);
+    if (exact_enumeration_cost <= monte_carlo_cost) {
+        return EXACT_ENUMERATION;
+    }
+    return MONTE_CARLO;
+}
+
+uint64_t round_up_to_whole_samples(uint64_t num_trials, uint16_t num_trials_per_sample) {
+    return (num_trials + num_trials_per_sample - 1) / num_trials_per_sample * num_trials_per_sample;
+}
+
+// Same as run_simulation, with at most max_num_workers threads. Also sets the hero's equity curve, unless equity_curve
+// is NULL; the stopping rule then applies to its standard errors. Likewise for the alternative heroes' equities, unless
+// hero_comparison is NULL (the hero's hole cards must be known). The exact tallies are copied to simulation_totals,
+// unless it is NULL. Returns false, with meaningless results, if the ranges can't be dealt together.
+bool run_simulation_on_threads(Game* game, WinningProbabilityDistribution* winning_probability_distribution, StoppingRule* stopping_rule, EquityCurve* equity_curve, HeroComparison* hero_comparison, SimulationTotals* simulation_totals, uint16_t max_num_workers) {
+    double start = get_time_in_seconds();
+    PROFILE_START();
+    Deck unseen_cards = get_deck_from_card_mask(get_unseen_cards_from_perspective_of_tv_watcher(&game->players, &game->community_cards));
+    uint8_t method = choose_simulation_method(game, unseen_cards.count, stopping_rule);
+    uint8_t sampling_method = choose_sampling_method(game, method, equity_curve, hero_comparison);
+    uint16_t num_trials_per_sample = get_num_trials_per_sample(sampling_method, unseen_cards.count);
+    uint64_t max_num_trials = round_up_to_whole_samples(stopping_rule->max_num_trials, num_trials_per_sample);
+    if (method == EXACT_ENUMERATION) {
+        max_num_trials = binomial_coefficients[unseen_cards.count][MAX_NUM_COMMUNITY_CARDS - game->community_cards.count];
+    }
+    uint64_t num_trials_per_chunk = round_up_to_whole_samples(NUM_TRIALS_PER_CHUNK, num_trials_per_sample);
+    uint64_t first_trial = 0;
+    uint64_t num_trials = max_num_trials;
+    if (num_shards > 1) {
+        uint64_t num_samples = max_num_trials / num_trials_per_sample;
+        first_trial = num_samples * shard_index / num_shards * num_trials_per_sample;
+        num_trials = num_samples * (shard_index + 1) / num_shards * num_trials_per_sample - first_trial;
+    }
+
+    uint16_t num_workers = max_num_workers;
+    if (num_workers > (num_trials + num_trials_per_chunk - 1) / num_trials_per_chunk) {
+        num_workers = (num_trials + num_trials_per_chunk - 1) / num_trials_per_chunk;
+    }
+    if (num_workers == 0) {
+        num_workers = 1;
+    }
+    SimulationWorker* workers = aligned_alloc(CACHE_LINE_SIZE, num_workers * sizeof(SimulationWorker));
+    ChunkQueue* chunk_queues = malloc(num_workers * sizeof(ChunkQueue));
+
+    // callers check that each range can be dealt before simulating, but only drawing them shows whether they can all be
+    bool has_failed = false;
+    bool has_ranges = get_num_players_with_ranges(&game->players) > 0;
+    if (has_ranges == true) {
+        init_range_samplers(&game->players, FULL_DECK_CARD_MASK & ~unseen_cards.mask);
+    }
+
+    pthread_mutex_lock(&main_random_number_generator_lock);
+    uint64_t seed = get_random_seed(&main_random_number_generator);
+    pthread_mutex_unlock(&main_random_number_generator_lock);
+    uint16_t i;
+    for (i = 0; i < num_workers; ++i) {
+        pthread_mutex_init(&chunk_queues[i].lock, NULL);
+
+        SimulationWorker* worker = &workers[i];
+        worker->game = game;
+        init_trial_scratch(&worker->scratch, game, &unseen_cards);
+        worker->method = method;
+        worker->sampling_method = sampling_method;
+        worker->num_trials_per_sample = num_trials_per_sample;
+        worker->num_trials_in_sample = 0;
+        worker->num_trials_per_chunk = num_trials_per_chunk;
+        worker->deadline = 0;
+        if (method == MONTE_CARLO && stopping_rule->max_num_seconds > 0) {
+            worker->deadline = start + stopping_rule->max_num_seconds;
+        }
+        worker->chunk_queues = chunk_queues;
+        worker->num_workers = num_workers;
+        worker->index = i;
+        worker->is_reproducible = is_seeded;
+        worker->seed = seed;
+        if (is_seeded == true) {
+            worker->random_number_generator = init_random_number_generator(SPLITMIX64, seed, 0);
+        }
+        else {
+            worker->random_number_generator = init_random_number_generator(random_number_generator_algorithm, seed, i);
+        }
+        init_simulation_totals(&worker->totals, game->players.count, num_trials_per_sample);
+        worker->range_combination_equities = NULL;
+        worker->range_combination_num_trials = NULL;
+        if (has_ranges == true) {
+            worker->range_combination_equities = calloc(game->players.count * NUM_HOLE_CARDS_COMBINATIONS, sizeof(double));
+            worker->range_combination_num_trials = calloc(game->players.count * NUM_HOLE_CARDS_COMBINATIONS, sizeof(uint64_t));
+        }
+        worker->is_equity_curve_tallied = equity_curve != NULL;
+        for (uint8_t j = 0; j <= MAX_NUM_PLAYERS; ++j) {
+            worker->equity_curve_wins[j] = 0;
+            worker->equity_curve_tied_wins[j] = 0;
+            worker->equity_curve_squared_wins[j] = 0;
+        }
+        worker->hero_comparison = hero_comparison;
+        for (uint8_t j = 0; j < MAX_NUM_ALTERNATIVE_HEROES; ++j) {
+            worker->hero_comparison_wins[j] = 0;
+            worker->hero_comparison_squared_wins[j] = 0;
+            worker->hero_comparison_differences[j] = 0;
+            worker->hero_comparison_squared_differences[j] = 0;
+        }
+        worker->num_trials_run = 0;
+        worker->has_failed = &has_failed;
+    }
+    PROFILE_END(SETUP_STAGE);
+
+    SimulationTotals totals;
+    if (method == EXACT_ENUMERATION || stopping_rule->target_standard_error <= 0 || num_shards > 1) {
+        run_simulation_round(workers, chunk_queues, num_workers, first_trial, num_trials);
+        set_winning_probability_distribution_from_workers(winning_probability_distribution, &totals, workers, num_workers, game->players.count);
+        if (equity_curve != NULL) {
+            set_equity_curve_from_workers(equity_curve, workers, num_workers, game->players.count);
+        }
+        if (hero_comparison != NULL) {
+            set_hero_comparison_from_workers(hero_comparison, winning_probability_distribution, workers, num_workers);
+        }
+    }
+    else {
+        // Each round aims at the number of trials the current variances say the target needs
+        uint64_t num_trials_in_round = round_up_to_whole_samples(MIN_NUM_TRIALS_BEFORE_STOPPING, num_trials_per_sample);
+        uint64_t num_trials_run = 0;
+        while (true) {
+            if (num_trials_in_round > max_num_trials - num_trials_run) {
+                num_trials_in_round = max_num_trials - num_trials_run;
+            }
+            run_simulation_round(workers, chunk_queues, num_workers, num_trials_run, num_trials_in_round);
+            set_winning_probability_distribution_from_workers(winning_probability_distribution, &totals, workers, num_workers, game->players.count);
+            num_trials_run = winning_probability_distribution->num_trials;
+
+            double max_standard_error;
+            if (equity_curve != NULL) {
+                set_equity_curve_from_workers(equity_curve, workers, num_workers, game->players.count);
+                max_standard_error = get_max_standard_error_of_equity_curve(equity_curve);
+            }
+            else {
+                max_standard_error = get_max_standard_error(winning_probability_distribution, game->players.count);
+            }
+            if (hero_comparison != NULL) {
+                set_hero_comparison_from_workers(hero_comparison, winning_probability_distribution, workers, num_workers);
+            }
+            if (has_failed == true || max_standard_error <= stopping_rule->target_standard_error || num_trials_run >= max_num_trials) {
+                break;
+            }
+            if (stopping_rule->max_num_seconds > 0 && get_time_in_seconds() - start >= stopping_rule->max_num_seconds) {
+                break;
+            }
+            double num_trials_needed = num_trials_run * (max_standard_error / stopping_rule->target_standard_error) * (max_standard_error / stopping_rule->target_standard_error);
+            num_trials_in_round = num_trials_needed - num_trials_run;
+            if (num_trials_in_round < NUM_TRIALS_PER_CHUNK) {
+                num_trials_in_round = NUM_TRIALS_PER_CHUNK;
+            }
+            num_trials_in_round = round_up_to_whole_samples(num_trials_in_round, num_trials_per_sample);
+        }
+    }
+    winning_probability_distribution->method = method;
+    winning_probability_distribution->is_cached = false;
+    if (simulation_totals != NULL) {
+        *simulation_totals = totals;
+    }
+    if (has_ranges == true) {
+        set_range_combination_equities_from_workers(&game->players, workers, num_workers);
+    }
+
+    for (i = 0; i < num_workers; ++i) {
+        pthread_mutex_destroy(&chunk_queues[i].lock);
+        free(workers[i].range_combination_equities);
+        free(workers[i].range_combination_num_trials);
+    }
+    free(workers);
+    free(chunk_queues);
+    FLUSH_PROFILE_COUNTERS();
+    return has_failed == false;
+}
+
+bool run_simulation(Game* game, WinningProbabilityDistribution* winning_probability_distribution, StoppingRule* stopping_rule, EquityCurve* equity_curve, HeroComparison* hero_comparison, SimulationTotals* simulation_totals) {
+    return run_simulation_on_threads(game, winning_probability_distribution, stopping_rule, equity_curve, hero_comparison, simulation_totals, num_threads);
+}
+
+bool set_winning_probability_distribution(Game* game, WinningProbabilityDistribution* winning_probability_distribution, StoppingRule* stopping_rule) {
+    return run_simulation(game, winning_probability_distribution, stopping_rule, NULL, NULL, NULL);
+}
+
+// #############################################
+// Result cache
+// #############################################
+
+// Spots that only differ by a permutation of the suits have the same equities, so they share a cache entry
+#define NUM_SUIT_PERMUTATIONS 24
+#define DEFAULT_RESULT_CACHE_CAPACITY 4096
+
+uint8_t suit_permutations[NUM_SUIT_PERMUTATIONS][NUM_SUITS];
+
+// The canonical spot is the suit permutation of it whose community cards, then hole cards in player order, are the smallest masks.
+// The settings that change the results are part of the key too.
+typedef struct {
+    CardMask community_cards;
+    CardMask players_hole_cards[MAX_NUM_PLAYERS];
+    uint8_t num_players;
+    uint8_t method;
+    uint64_t max_num_trials;
+    double target_standard_error;
+} SpotKey;
+
+typedef struct CacheEntry {
+    SpotKey key;
+    WinningProbabilityDistribution value;
+    struct CacheEntry* next_in_bucket;
+    struct CacheEntry* more_recently_used;
+    struct CacheEntry* less_recently_used;
+} CacheEntry;
+
+// Bounded hash table with least-recently-used eviction, shared by all threads
+typedef struct {
+    pthread_mutex_t lock;
+    CacheEntry* entries;
+    uint32_t capacity;
+    uint32_t count;
+    CacheEntry** buckets;
+    uint32_t num_buckets;
+    CacheEntry* most_recently_used;
+    CacheEntry* least_recently_used;
+    uint64_t num_hits;
+    uint64_t num_misses;
+} ResultCache;
+
+uint32_t result_cache_capacity = DEFAULT_RESULT_CACHE_CAPACITY;
+ResultCache result_cache;
+
+void init_suit_permutations() {
+    uint8_t num_permutations = 0;
+    for (uint8_t a = 0; a < NUM_SUITS; ++a) {
+        for (uint8_t b = 0; b < NUM_SUITS; ++b) {
+            for (uint8_t c = 0; c < NUM_SUITS; ++c) {
+                uint8_t d = (0 + 1 + 2 + 3) - a - b - c;
+                if (a == b || a == c || b == c || d >= NUM_SUITS || d == a || d == b || d == c) {
+                    continue;
+                }
+                suit_permutations[num_permutations][0] = a;
+                suit_permutations[num_permutations][1] = b;
+                suit_permutations[num_permutations][2] = c;
+                suit_permutations[num_permutations][3] = d;
+                ++num_permutations;
+            }
+        }
+    }
+}
+
+void init_result_cache() {
+    init_suit_permutations();
+    pthread_mutex_init(&result_cache.lock, NULL);
+    result_cache.capacity = result_cache_capacity;
+    result_cache.count = 0;
+    result_cache.num_buckets = 2 * result_cache_capacity + 1;
+    result_cache.entries = malloc(result_cache.capacity * sizeof(CacheEntry));
+    result_cache.buckets = calloc(result_cache.num_buckets, sizeof(CacheEntry*));
+    result_cache.most_recently_used = NULL;
+    result_cache.least_recently_used = NULL;
+    result_cache.num_hits = 0;
+    result_cache.num_misses = 0;
+}
+
+CardMask permute_suits(CardMask cards, uint8_t* suit_permutation) {
+    CardMask res = 0;
+    for (uint8_t suit = MIN_SUIT; suit <= MAX_SUIT; ++suit) {
+        res |= ((CardMask) get_suit_rank_mask(cards, suit)) << (suit_permutation[suit] * NUM_CARD_RANKS);
+    }
+    return res;
+}
+
+void get_canonical_spot_key(Game* game, StoppingRule* stopping_rule, SpotKey* key) {
+    memset(key, 0, sizeof(SpotKey));
+    key->num_players = game->players.count;
+    key->method = simulation_method;
+    key->max_num_trials = stopping_rule->max_num_trials;
+    key->target_standard_error = stopping_rule->target_standard_error;
+
+    bool has_candidate = false;
+    for (uint8_t permutation = 0; permutation < NUM_SUIT_PERMUTATIONS; ++permutation) {
+        uint8_t* suit_permutation = suit_permutations[permutation];
+        CardMask community_cards = permute_suits(game->community_cards.mask, suit_permutation);
+        // -1: smaller than the best candidate so far, 1: larger, 0: equal up to the current player
+        int8_t comparison = has_candidate == false || community_cards < key->community_cards ? -1 : (community_cards > key->community_cards ? 1 : 0);
+        if (comparison > 0) {
+            continue;
+        }
+        CardMask players_hole_cards[MAX_NUM_PLAYERS];
+        for (uint8_t i = 0; i < game->players.count; ++i) {
+            players_hole_cards[i] = permute_suits(game->players.hole_cards[i].mask, suit_permutation);
+            if (comparison == 0) {
+                comparison = players_hole_cards[i] < key->players_hole_cards[i] ? -1 : (players_hole_cards[i] > key->players_hole_cards[i] ? 1 : 0);
+                if (comparison > 0) {
+                    break;
+                }
+            }
+        }
+        if (comparison < 0) {
+            key->community_cards = community_cards;
+            memcpy(key->players_hole_cards, players_hole_cards, game->players.count * sizeof(CardMask));
+            has_candidate = true;
+        }
+    }
+}
+
+uint32_t get_spot_key_bucket(SpotKey* key) {
+    uint64_t hash = key->community_cards ^ (((uint64_t) key->num_players) << 56) ^ (((uint64_t) key->method) << 48) ^ key->max_num_trials;
+    for (uint8_t i = 0; i < key->num_players; ++i) {
+        hash = (hash ^ key->players_hole_cards[i]) * 0x100000001B3;
+        hash ^= hash >> 29;
+    }
+    return splitmix64(&hash) % result_cache.num_buckets;
+}
+
+CacheEntry* find_cache_entry(SpotKey* key, uint32_t bucket) {
+    for (CacheEntry* entry = result_cache.buckets[bucket]; entry != NULL; entry = entry->next_in_bucket) {
+        if (memcmp(&entry->key, key, sizeof(SpotKey)) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+void unlink_cache_entry_from_recency_list(CacheEntry* entry) {
+    if (entry->more_recently_used != NULL) {
+        entry->more_recently_used->less_recently_used = entry->less_recently_used;
+    }
+    else {
+        result_cache.most_recently_used = entry->less_recently_used;
+    }
+    if (entry->less_recently_used != NULL) {
+        entry->less_recently_used->more_recently_used = entry->more_recently_used;
+    }
+    else {
+        result_cache.least_recently_used = entry->more_recently_used;
+    }
+}
+
+void link_cache_entry_as_most_recently_used(CacheEntry* entry) {
+    entry->more_recently_used = NULL;
+    entry->less_recently_used = result_cache.most_recently_used;
+    if (result_cache.most_recently_used != NULL) {
+        result_cache.most_recently_used->more_recently_used = entry;
+    }
+    result_cache.most_recently_used = entry;
+    if (result_cache.least_recently_used == NULL) {
+        result_cache.least_recently_used = entry;
+    }
+}
+
+void unlink_cache_entry_from_bucket(CacheEntry* entry) {
+    CacheEntry** link = &result_cache.buckets[get_spot_key_bucket(&entry->key)];
+    while (*link != entry) {
+        link = &(*link)->next_in_bucket;
+    }
+    *link = entry->next_in_bucket;
+}
+
+void insert_cache_entry(SpotKey* key, uint32_t bucket, WinningProbabilityDistribution* value) {
+    CacheEntry* entry = find_cache_entry(key, bucket);
+    if (entry != NULL) {
+        unlink_cache_entry_from_recency_list(entry);
+    }
+    else {
+        if (result_cache.count < result_cache.capacity) {
+            entry = &result_cache.entries[(result_cache.count)++];
+        }
+        else {
+            entry = result_cache.least_recently_used;
+            unlink_cache_entry_from_recency_list(entry);
+            unlink_cache_entry_from_bucket(entry);
+        }
+        entry->key = *key;
+        entry->next_in_bucket = result_cache.buckets[bucket];
+        result_cache.buckets[bucket] = entry;
+    }
+    entry->value = *value;
+    link_cache_entry_as_most_recently_used(entry);
+}
+
+// set_winning_probability_distribution behind the result cache
+bool set_cached_winning_probability_distribution(Game* game, WinningProbabilityDistribution* winning_probability_distribution, StoppingRule* stopping_rule) {
+    // the ranges aren't part of the key, and only they can fail
+    if (result_cache.capacity == 0 || get_num_players_with_ranges(&game->players) > 0) {
+        return set_winning_probability_distribution(game, winning_probability_distribution, stopping_rule);
+    }
+    SpotKey key;
+    get_canonical_spot_key(game, stopping_rule, &key);
+    uint32_t bucket = get_spot_key_bucket(&key);
+
+    pthread_mutex_lock(&result_cache.lock);
+    CacheEntry* entry = find_cache_entry(&key, bucket);
+    if (entry != NULL) {
+        ++(result_cache.num_hits);
+        unlink_cache_entry_from_recency_list(entry);
+        link_cache_entry_as_most_recently_used(entry);
+        *winning_probability_distribution = entry->value;
+        pthread_mutex_unlock(&result_cache.lock);
+        winning_probability_distribution->is_cached = true;
+        return true;
+    }
+    ++(result_cache.num_misses);
+    pthread_mutex_unlock(&result_cache.lock);
+
+    set_winning_probability_distribution(game, winning_probability_distribution, stopping_rule);
+
+    // a run cut short by its time budget isn't what the key promises
+    bool is_cut_short = winning_probability_distribution->method == MONTE_CARLO && winning_probability_distribution->num_trials < stopping_rule->max_num_trials;
+    if (stopping_rule->target_standard_error > 0 && get_max_standard_error(winning_probability_distribution, game->players.count) <= stopping_rule->target_standard_error) {
+        is_cut_short = false;
+    }
+    if (is_cut_short == true) {
+        return true;
+    }
+    pthread_mutex_lock(&result_cache.lock);
+    insert_cache_entry(&key, bucket, winning_probability_distribution);
+    pthread_mutex_unlock(&result_cache.lock);
+    return true;
+}
+
+// #############################################
+// Street-to-street simulation
+// #############################################
+
+// When the hole cards are all known, the board completions of the turn and the river are board completions of the flop
+// too. So replaying a game records the completions of the exactly enumerated streets from the flop on, and a later
+// enumerated street only evaluates the ones that were never evaluated before (none at all after an enumerated flop).
+// The other streets are simulated as usual: a preflop or Monte Carlo street's runouts rarely hold the next street's
+// cards, so recording them doesn't pay for itself.
+
+#define EMPTY_RUNOUT_INDEX_SLOT UINT32_MAX
+
+// The table holds every completion of the game's flop, which the later streets' completions are part of. It is left
+// empty (and never records) if it can't be allocated.
+RunoutTable init_runout_table(uint8_t num_players) {
+    RunoutTable res;
+    res.capacity = binomial_coefficients[STANDARD_DECK_SIZE - num_players * NUM_HOLE_CARDS_PER_PLAYER - 3][2];
+    res.num_runouts = 0;
+    // the index is at most half full
+    res.index_size = 1;
+    while (res.index_size < 2 * res.capacity) {
+        res.index_size *= 2;
+    }
+    res.runouts = malloc(res.capacity * sizeof(Runout));
+    res.index = malloc(res.index_size * sizeof(uint32_t));
+    if (res.runouts == NULL || res.index == NULL) {
+        free(res.runouts);
+        free(res.index);
+        res.runouts = NULL;
+        res.index = NULL;
+        res.capacity = 0;
+    }
+    return res;
+}
+
+void free_runout_table(RunoutTable* runout_table) {
+    free(runout_table->runouts);
+    free(runout_table->index);
+}
+
+uint32_t get_runout_index_slot(RunoutTable* runout_table, CardMask community_cards) {
+    uint64_t hash = community_cards * 0x9E3779B97F4A7C15ULL;
+    return (hash >> 32) & (runout_table->index_size - 1);
+}
+
+// Returns the recorded runout of the community cards, or NULL
+Runout* find_runout(RunoutTable* runout_table, CardMask community_cards) {
+    for (uint32_t slot = get_runout_index_slot(runout_table, community_cards); runout_table->index[slot] != EMPTY_RUNOUT_INDEX_SLOT; slot = (slot + 1) & (runout_table->index_size - 1)) {
+        Runout* runout = &runout_table->runouts[runout_table->index[slot]];
+        if (runout->community_cards == community_cards) {
+            return runout;
+        }
+    }
+    return NULL;
+}
+
+void add_runout_to_index(RunoutTable* runout_table, uint32_t runout_index) {
+    uint32_t slot = get_runout_index_slot(runout_table, runout_table->runouts[runout_index].community_cards);
+    while (runout_table->index[slot] != EMPTY_RUNOUT_INDEX_SLOT) {
+        slot = (slot + 1) & (runout_table->index_size - 1);
+    }
+    runout_table->index[slot] = runout_index;
+}
+
+// Indexes the recorded runouts that hold the community cards, and returns how many there are
+uint32_t index_runouts(RunoutTable* runout_table, CardMask community_cards) {
+    uint32_t res = 0;
+    memset(runout_table->index, 0xFF, runout_table->index_size * sizeof(uint32_t));
+    for (uint32_t i = 0; i < runout_table->num_runouts; ++i) {
+        if ((runout_table->runouts[i].community_cards & community_cards) == community_cards && find_runout(runout_table, runout_table->runouts[i].community_cards) == NULL) {
+            add_runout_to_index(runout_table, i);
+            ++res;
+        }
+    }
+    return res;
+}
+
+// Sums of the players' shares of the pot, of their squares and of the split-pot shares over a street's runouts
+typedef struct {
+    double wins_distribution[MAX_NUM_PLAYERS];
+    double tied_wins_distribution[MAX_NUM_PLAYERS];
+    double squared_wins_distribution[MAX_NUM_PLAYERS];
+    uint64_t num_trials;
+} RunoutTally;
+
+void tally_runout(RunoutTally* tally, uint32_t winners, uint8_t num_players) {
+    double equity_for_each_winner = (double) 1 / __builtin_popcount(winners);
+    for (uint8_t i = 0; i < num_players; ++i) {
+        if (winners & (1 << i)) {
+            tally->wins_distribution[i] += equity_for_each_winner;
+            tally->squared_wins_distribution[i] += equity_for_each_winner * equity_for_each_winner;
+            if (equity_for_each_winner < 1) {
+                tally->tied_wins_distribution[i] += equity_for_each_winner;
+            }
+        }
+    }
+    ++(tally->num_trials);
+}
+
+void set_winning_probability_distribution_from_tally(WinningProbabilityDistribution* winning_probability_distribution, RunoutTally* tally, uint8_t num_players) {
+    uint64_t iters = tally->num_trials;
+    for (uint8_t i = 0; i < num_players; ++i) {
+        double mean = tally->wins_distribution[i] / iters;
+        winning_probability_distribution->equities[i] = mean;
+        winning_probability_distribution->tie_equities[i] = tally->tied_wins_distribution[i] / iters;
+        winning_probability_distribution->standard_errors[i] = 0;
+        if (iters > 1) {
+            double variance = (tally->squared_wins_distribution[i] - iters * mean * mean) / (iters - 1);
+            if (variance > 0) {
+                winning_probability_distribution->standard_errors[i] = sqrt(variance / iters);
+            }
+        }
+    }
+    winning_probability_distribution->num_trials = iters;
+    winning_probability_distribution->is_cached = false;
+}
+
+// Every board completion, from the recorded runouts when possible; the evaluated ones are recorded, and there is
+// always room for them since the street is on the flop or later
+void enumerate_street_from_runouts(Game* game, RunoutTable* runout_table, Deck* unseen_cards, RunoutTally* tally) {
+    uint8_t num_community_cards_to_deal = MAX_NUM_COMMUNITY_CARDS - game->community_cards.count;
+    uint64_t num_board_completions = binomial_coefficients[unseen_cards->count][num_community_cards_to_deal];
+    uint32_t num_indexed_runouts = index_runouts(runout_table, game->community_cards.mask);
+    BoardState fixed_board_state = get_board_state(game->community_cards.mask);
+    CardMask players_hole_cards[MAX_NUM_PLAYERS];
+    for (uint8_t i = 0; i < game->players.count; ++i) {
+        players_hole_cards[i] = game->players.hole_cards[i].mask;
+    }
+    uint8_t card_indices[MAX_NUM_COMMUNITY_CARDS];
+    unrank_combination(0, num_community_cards_to_deal, card_indices);
+    for (uint64_t iters = 0; iters < num_board_completions; ++iters) {
+        CardMask community_cards = game->community_cards.mask;
+        for (uint8_t i = 0; i < num_community_cards_to_deal; ++i) {
+            community_cards |= get_card_mask(&unseen_cards->cards[card_indices[i]]);
+        }
+        Runout* runout = num_indexed_runouts > 0 ? find_runout(runout_table, community_cards) : NULL;
+        if (runout == NULL) {
+            uint32_t players_strongest_hands[MAX_NUM_PLAYERS];
+            double players_equities[MAX_NUM_PLAYERS];
+            set_players_strongest_hands_on_dealt_board(players_strongest_hands, players_hole_cards, game->players.count, &fixed_board_state, game->community_cards.mask, community_cards & ~game->community_cards.mask);
+            set_players_equities_from_strongest_hands(players_equities, players_strongest_hands, game->players.count);
+            runout = &runout_table->runouts[runout_table->num_runouts];
+            runout->community_cards = community_cards;
+            runout->winners = get_winners(players_equities, game->players.count);
+            add_runout_to_index(runout_table, runout_table->num_runouts++);
+        }
+        tally_runout(tally, runout->winners, game->players.count);
+        if (num_community_cards_to_deal > 0) {
+            advance_combination(num_community_cards_to_deal, card_indices);
+        }
+    }
+}
+
+// Same as set_winning_probability_distribution for a game whose hole cards are all known, reusing the board completions
+// of the earlier streets recorded in the table and recording the new ones when the street is exactly enumerated from the
+// flop on. num_reused_runouts is set to how many of the street's trials were recorded board completions.
+void set_street_winning_probability_distribution(Game* game, RunoutTable* runout_table, WinningProbabilityDistribution* winning_probability_distribution, StoppingRule* stopping_rule, uint64_t* num_reused_runouts) {
+    Deck unseen_cards = get_deck_from_card_mask(get_unseen_cards_from_perspective_of_tv_watcher(&game->players, &game->community_cards));
+    uint8_t method = choose_simulation_method(game, unseen_cards.count, stopping_rule);
+    *num_reused_runouts = 0;
+    if (method != EXACT_ENUMERATION || game->community_cards.count < 3 || runout_table->capacity == 0) {
+        set_winning_probability_distribution(game, winning_probability_distribution, stopping_rule);
+        return;
+    }
+    RunoutTally tally;
+    memset(&tally, 0, sizeof(tally));
+    uint64_t num_runouts_before = runout_table->num_runouts;
+    enumerate_street_from_runouts(game, runout_table, &unseen_cards, &tally);
+    *num_reused_runouts = tally.num_trials - (runout_table->num_runouts - num_runouts_before);
+    set_winning_probability_distribution_from_tally(winning_probability_distribution, &tally, game->players.count);
+    winning_probability_distribution->method = method;
+}
+
+// #############################################
+// Sharded simulations
+// #############################################
+
+#define PARTIAL_RESULTS_MAGIC "THPARTRS"
+#define PARTIAL_RESULTS_VERSION 2
+// Bumped whenever seeded trials would deal or tally differently, so that shards of different builds never merge
+#define SIMULATION_ENGINE_VERSION 1
+
+// The file is a header followed by the shard's totals, in native byte order
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t engine_version;
+    uint32_t shard_index;
+    uint32_t num_shards;
+    // identifies the simulation the shard is part of (see get_simulation_hash)
+    uint64_t simulation_hash;
+    uint8_t method;
+    uint8_t padding[7];
+} PartialResultsHeader;
+
+const char* partial_results_path_option = NULL;
+
+#define FNV_OFFSET_BASIS 0xCBF29CE484222325
+#define FNV_PRIME 0x100000001B3
+
+uint64_t hash_bytes(uint64_t hash, const void* data, size_t size) {
+    const uint8_t* bytes = data;
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+// Everything a seeded simulation's trials depend on: the spot, the seed, the method, the sampling and the number of trials
+uint64_t get_simulation_hash(Game* game, uint8_t method, SimulationTotals* totals, StoppingRule* stopping_rule) {
+    uint64_t res = hash_bytes(FNV_OFFSET_BASIS, &game->community_cards.mask, sizeof(CardMask));
+    res = hash_bytes(res, &game->players.count, sizeof(game->players.count));
+    for (uint8_t i = 0; i < game->players.count; ++i) {
+        res = hash_bytes(res, &game->players.hole_cards[i].mask, sizeof(CardMask));
+        if (game->players.ranges[i] != NULL) {
+            res = hash_bytes(res, game->players.ranges[i]->weights, sizeof(game->players.ranges[i]->weights));
+        }
+    }
+    uint8_t sampling_method = choose_sampling_method(game, method, NULL, NULL);
+    res = hash_bytes(res, &seed_option, sizeof(seed_option));
+    res = hash_bytes(res, &method, sizeof(method));
+    res = hash_bytes(res, &sampling_method, sizeof(sampling_method));
+    res = hash_bytes(res, &totals->num_trials_per_sample, sizeof(totals->num_trials_per_sample));
+    res = hash_bytes(res, &stopping_rule->max_num_trials, sizeof(stopping_rule->max_num_trials));
+    return res;
+}
+
+bool write_partial_results(const char* path, Game* game, uint8_t method, SimulationTotals* totals) {
+    PartialResultsHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, PARTIAL_RESULTS_MAGIC, sizeof(header.magic));
+    header.version = PARTIAL_RESULTS_VERSION;
+    header.engine_version = SIMULATION_ENGINE_VERSION;
+    header.shard_index = shard_index;
+    header.num_shards = num_shards;
+    header.simulation_hash = get_simulation_hash(game, method, totals, &stopping_rule_option);
+    header.method = method;
+
+    // Written next to the destination and renamed over it, so a merge never reads a half-written file
+    char temporary_path[4096];
+    snprintf(temporary_path, sizeof(temporary_path), "%s.tmp", path);
+    FILE* file = fopen(temporary_path, "wb");
+    if (file == NULL) {
+        perror(temporary_path);
+        return false;
+    }
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(totals, sizeof(SimulationTotals), 1, file) == 1;
+    if (fclose(file) != 0 || written == false || rename(temporary_path, path) != 0) {
+        perror(path);
+        return false;
+    }
+    fprintf(stderr, "Wrote shard %u of %u to %s\n", shard_index, num_shards, path);
+    return true;
+}
+
+bool read_partial_results(const char* path, PartialResultsHeader* header, SimulationTotals* totals) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        perror(path);
+        return false;
+    }
+    bool is_read = fread(header, sizeof(PartialResultsHeader), 1, file) == 1 && fread(totals, sizeof(SimulationTotals), 1, file) == 1;
+    fclose(file);
+    if (is_read == false || memcmp(header->magic, PARTIAL_RESULTS_MAGIC, sizeof(header->magic)) != 0 || header->version != PARTIAL_RESULTS_VERSION) {
+        fprintf(stderr, "%s: not version %d partial results\n", path, PARTIAL_RESULTS_VERSION);
+        return false;
+    }
+    if (header->engine_version != SIMULATION_ENGINE_VERSION) {
+        fprintf(stderr, "%s: written by version %u of the simulation engine, not %d\n", path, header->engine_version, SIMULATION_ENGINE_VERSION);
+        return false;
+    }
+    if (header->num_shards == 0 || header->shard_index >= header->num_shards || totals->num_players < MIN_NUM_PLAYERS || totals->num_players > MAX_NUM_PLAYERS || totals->num_trials_per_sample == 0) {
+        fprintf(stderr, "%s: corrupt partial results\n", path);
+        return false;
+    }
+    return true;
+}
+
+// #############################################
+// Outs
+// #############################################
+
+// Every unseen card that can come next on the flop or the turn gets its own simulation of the rest of the hand:
+// exact on the turn, where only the river is left once the hole cards are known, and Monte Carlo otherwise. Each
+// thread takes the next card to simulate and runs the whole simulation on its own, so the threads never wait on each
+// other within the many short simulations. The fixed board's state is worked out once per simulation chunk, and each
+// trial only adds the cards it deals (see set_players_strongest_hands_on_dealt_board).
+
+typedef struct {
+    uint8_t card_index;
+    // false if the ranges can't be dealt once the card is dealt
+    bool is_possible;
+    WinningProbabilityDistribution winning_probability_distribution;
+} NextCardEquities;
+
+typedef struct {
+    Game* game;
+    StoppingRule* stopping_rule;
+    NextCardEquities* next_cards_equities;
+    uint8_t num_next_cards;
+    // the next card to simulate, shared by the threads
+    uint8_t next_card;
+} OutsAnalysis;
+
+// The game once the deck's next card (card_index) is dealt by the next street's logic, which burns another card first
+Game deal_next_card(Game* game, uint8_t card_index) {
+    Game res = *game;
+    CardMask card = (CardMask) 1 << card_index;
+    CardMask deck_cards = get_unseen_cards_from_perspective_of_tv_watcher(&game->players, &game->community_cards) & ~game->burned_cards.mask;
+    // the top of the deck is its last card: the burned card, and then card_index
+    res.deck = get_deck_from_card_mask(deck_cards & ~card);
+    res.deck.cards[res.deck.count] = res.deck.cards[res.deck.count - 1];
+    get_cards_from_card_mask(card, &res.deck.cards[res.deck.count - 1]);
+    ++(res.deck.count);
+    res.deck.mask |= card;
+    if (game->community_cards.count == 3) {
+        deal_the_turn(&res.community_cards, &res.deck, &res.burned_cards);
+    }
+    else {
+        deal_the_river(&res.community_cards, &res.deck, &res.burned_cards);
+    }
+    return res;
+}
+
+// ranges has room for a copy of every player's range: a simulation sets up the range samplers for its own dead cards
+void set_next_card_equities(OutsAnalysis* analysis, NextCardEquities* next_card_equities, Range* ranges) {
+    Game game = deal_next_card(analysis->game, next_card_equities->card_index);
+    for (uint8_t i = 0; i < game.players.count; ++i) {
+        if (game.players.ranges[i] != NULL) {
+            ranges[i] = *game.players.ranges[i];
+            game.players.ranges[i] = &ranges[i];
+        }
+    }
+    CardMask known_cards = FULL_DECK_CARD_MASK & ~get_unseen_cards_from_perspective_of_tv_watcher(&game.players, &game.community_cards);
+    next_card_equities->is_possible = init_range_samplers(&game.players, known_cards);
+    if (next_card_equities->is_possible == true) {
+        next_card_equities->is_possible = run_simulation_on_threads(&game, &next_card_equities->winning_probability_distribution, analysis->stopping_rule, NULL, NULL, NULL, 1);
+    }
+}
+
+void* run_outs_worker(void* arg) {
+    OutsAnalysis* analysis = arg;
+    Range* ranges = NULL;
+    if (get_num_players_with_ranges(&analysis->game->players) > 0) {
+        ranges = malloc(analysis->game->players.count * sizeof(Range));
+    }
+    while (true) {
+        uint8_t next_card = __atomic_fetch_add(&analysis->next_card, 1, __ATOMIC_RELAXED);
+        if (next_card >= analysis->num_next_cards) {
+            break;
+        }
+        set_next_card_equities(analysis, &analysis->next_cards_equities[next_card], ranges);
+    }
+    free(ranges);
+    return NULL;
+}
+
+// Sets the equities once each card of the deck is the next community card, for a game on the flop or the turn, and
+// returns the number of cards
+uint8_t set_next_cards_equities(Game* game, StoppingRule* stopping_rule, NextCardEquities* next_cards_equities) {
+    OutsAnalysis analysis;
+    analysis.game = game;
+    analysis.stopping_rule = stopping_rule;
+    analysis.next_cards_equities = next_cards_equities;
+    analysis.num_next_cards = 0;
+    analysis.next_card = 0;
+    CardMask deck_cards = get_unseen_cards_from_perspective_of_tv_watcher(&game->players, &game->community_cards) & ~game->burned_cards.mask;
+    for (CardMask cards = deck_cards; cards != 0; cards &= cards - 1) {
+        next_cards_equities[analysis.num_next_cards++].card_index = __builtin_ctzll(cards);
+    }
+
+    pthread_t threads[MAX_NUM_THREADS];
+    uint16_t num_workers = num_threads;
+    if (num_workers > analysis.num_next_cards) {
+        num_workers = analysis.num_next_cards;
+    }
+    // The calling thread is worker 0
+    uint16_t i;
+    for (i = 1; i < num_workers; ++i) {
+        pthread_create(&threads[i], NULL, run_outs_worker, &analysis);
+    }
+    run_outs_worker(&analysis);
+    for (i = 1; i < num_workers; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    return analysis.num_next_cards;
+}
+
+// #############################################
+// Deal datasets
+// #############################################
+
+// Random games dealt in bulk, with every player's equity on each street and their final hand, for training and
+// calibration. A file is a header followed by chunks of up to NUM_DEALS_PER_CHUNK deals, in native byte order. A chunk
+// is a header followed by its columns, each optionally compressed with zlib:
+//   - the deals' player counts: uint8_t per deal
+//   - the cards: 6-bit card indices (NO_CARD_CODE for the empty seats), packed one after the other from the low bits of
+//     each byte, with the 2 hole cards of each of the file's max_num_players seats and then the 5 community cards
+//     of each deal
+//   - the equities: uint16_t per deal, street (preflop, flop, turn, river) and seat, in units of 1 / EQUITY_SCALE
+//   - the final scores: uint32_t per deal and seat, as get_player_strongest_hand gives them
+// The equities are the tv watcher's (every hole card known). They are exact on the turn and the river, and come from
+// --deal-equity-trials random completions of the board preflop and on the flop (DEFAULT_NUM_DEAL_EQUITY_TRIALS, for a
+// standard error of at most 0.5 / sqrt(256), about 3.1%), which the file header records. Those completions are most
+// of a deal's cost, so they set how many deals a second a thread makes.
+// Each chunk's deals and completions are drawn from its own SplitMix64 sequence, seeded with a hash of the seed and the
+// chunk index, and the chunks are written in order, so a seeded file doesn't depend on the threads. A chunk can take
+// any number of random numbers (about 3e10 with the most equity trials), which no fixed share of one sequence holds.
+
+#define DEALS_MAGIC "THDEALS1"
+#define DEALS_VERSION 1
+#define NUM_DEALS_PER_CHUNK 65536
+#define DEFAULT_NUM_DEALS 1000000
+#define DEFAULT_NUM_DEAL_EQUITY_TRIALS 256
+
+#define CARD_CODE_NUM_BITS 6
+#define NO_CARD_CODE 63
+#define NUM_CARD_SLOTS_PER_DEAL(max_num_players) ((max_num_players) * NUM_HOLE_CARDS_PER_PLAYER + MAX_NUM_COMMUNITY_CARDS)
+#define EQUITY_SCALE 65535
+#define NUM_DEALT_STREETS 4
+
+// columns:
+#define NUM_PLAYERS_COLUMN 0
+#define CARDS_COLUMN 1
+#define EQUITIES_COLUMN 2
+#define STRONGEST_HANDS_COLUMN 3
+#define NUM_DEAL_COLUMNS 4
+
+// compressions:
+#define NO_COMPRESSION 0
+#define ZLIB_COMPRESSION 1
+
+uint8_t num_community_cards_by_dealt_street[NUM_DEALT_STREETS] = {0, 3, 4, 5};
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    // the number of seats of every deal, whatever its player count
+    uint8_t max_num_players;
+    uint8_t compression;
+    // the number of random board completions of the preflop and flop equities
+    uint16_t num_equity_trials;
+} DealsFileHeader;
+
+typedef struct {
+    uint32_t num_deals;
+    uint32_t padding;
+    // stored (possibly compressed) size and uncompressed size of each column, stored one after the other
+    uint64_t column_sizes[NUM_DEAL_COLUMNS];
+    uint64_t column_raw_sizes[NUM_DEAL_COLUMNS];
+} DealsChunkHeader;
+
+typedef struct {
+    uint8_t num_players;
+    // the hole cards of each player, then the community cards
+    uint8_t card_indices[NUM_CARD_SLOTS_PER_DEAL(MAX_NUM_PLAYERS)];
+    double equities[NUM_DEALT_STREETS][MAX_NUM_PLAYERS];
+    uint32_t strongest_hands[MAX_NUM_PLAYERS];
+} Deal;
+
+uint64_t num_deals_option = DEFAULT_NUM_DEALS;
+uint16_t num_deal_equity_trials_option = DEFAULT_NUM_DEAL_EQUITY_TRIALS;
+uint8_t deals_compression_option = NO_COMPRESSION;
+
+void get_deals_column_raw_sizes(uint32_t num_deals, uint8_t max_num_players, uint64_t* column_raw_sizes) {
+    column_raw_sizes[NUM_PLAYERS_COLUMN] = num_deals;
+    // one more byte, so that every code can be read as two bytes
+    column_raw_sizes[CARDS_COLUMN] = ((uint64_t) num_deals * NUM_CARD_SLOTS_PER_DEAL(max_num_players) * CARD_CODE_NUM_BITS + 7) / 8 + 1;
+    column_raw_sizes[EQUITIES_COLUMN] = (uint64_t) num_deals * NUM_DEALT_STREETS * max_num_players * sizeof(uint16_t);
+    column_raw_sizes[STRONGEST_HANDS_COLUMN] = (uint64_t) num_deals * max_num_players * sizeof(uint32_t);
+}
+
+// codes must be zeroed before the first code is set
+static inline void set_card_code(uint8_t* codes, uint64_t slot, uint8_t code) {
+    uint64_t bit = slot * CARD_CODE_NUM_BITS;
+    uint16_t shifted_code = (uint16_t) code << (bit % 8);
+    codes[bit / 8] |= shifted_code & 0xFF;
+    codes[bit / 8 + 1] |= shifted_code >> 8;
+}
+
+static inline uint8_t get_card_code(const uint8_t* codes, uint64_t slot) {
+    uint64_t bit = slot * CARD_CODE_NUM_BITS;
+    uint16_t two_bytes = codes[bit / 8] | ((uint16_t) codes[bit / 8 + 1] << 8);
+    return (two_bytes >> (bit % 8)) & ((1 << CARD_CODE_NUM_BITS) - 1);
+}
+
+// Each player's equity once the deck's first num_community_cards community cards (after the hole cards) are dealt:
+// exact from the turn on, and from num_equity_trials random completions of the board before
+void set_dealt_street_equities(double* players_equities, CardMask* players_hole_cards, uint8_t num_players, Deck* deck, uint8_t num_community_cards, uint16_t num_equity_trials, RandomNumberGenerator* random_number_generator) {
+    uint8_t num_hole_cards = num_players * NUM_HOLE_CARDS_PER_PLAYER;
+    CardMask community_cards = 0;
+    for (uint8_t j = 0; j < num_community_cards; ++j) {
+        community_cards |= get_card_mask(&deck->cards[num_hole_cards + j]);
+    }
+    // the rest of the board is dealt from the cards nobody has seen yet
+    Deck unseen_cards = init_deck();
+    for (uint8_t i = num_hole_cards + num_community_cards; i < deck->count; ++i) {
+        unseen_cards.cards[unseen_cards.count++] = deck->cards[i];
+        unseen_cards.mask |= get_card_mask(&deck->cards[i]);
+    }
+    uint8_t num_community_cards_to_deal = MAX_NUM_COMMUNITY_CARDS - num_community_cards;
+    uint32_t num_trials = num_equity_trials;
+    if (num_community_cards_to_deal == 0) {
+        num_trials = 1;
+    }
+    else if (num_community_cards_to_deal == 1) {
+        num_trials = unseen_cards.count;
+    }
+
+    BoardState board_state = get_board_state(community_cards);
+    uint32_t players_strongest_hands[MAX_NUM_PLAYERS];
+    double trial_equities[MAX_NUM_PLAYERS];
+    for (uint8_t i = 0; i < num_players; ++i) {
+        players_equities[i] = 0;
+    }
+    for (uint32_t trial = 0; trial < num_trials; ++trial) {
+        CardMask dealt_cards = 0;
+        if (num_community_cards_to_deal == 1) {
+            dealt_cards = get_card_mask(&unseen_cards.cards[trial]);
+        }
+        else if (num_community_cards_to_deal > 1) {
+            dealt_cards = draw_random_cards(&unseen_cards, num_community_cards_to_deal, random_number_generator);
+        }
+        set_players_strongest_hands_on_dealt_board(players_strongest_hands, players_hole_cards, num_players, &board_state, community_cards, dealt_cards);
+        set_players_equities_from_strongest_hands(trial_equities, players_strongest_hands, num_players);
+        for (uint8_t i = 0; i < num_players; ++i) {
+            players_equities[i] += trial_equities[i];
+        }
+    }
+    for (uint8_t i = 0; i < num_players; ++i) {
+        players_equities[i] /= num_trials;
+    }
+}
+
+// Draws a game's hole cards and community cards to the front of the deck, with every player's equity on each street
+void deal_random_game(Deal* deal, uint8_t num_players, Deck* deck, uint16_t num_equity_trials, RandomNumberGenerator* random_number_generator) {
+    uint8_t num_hole_cards = num_players * NUM_HOLE_CARDS_PER_PLAYER;
+    draw_random_cards(deck, num_hole_cards + MAX_NUM_COMMUNITY_CARDS, random_number_generator);
+    CardMask players_hole_cards[MAX_NUM_PLAYERS];
+    for (uint8_t i = 0; i < num_players; ++i) {
+        players_hole_cards[i] = get_card_mask(&deck->cards[2 * i]) | get_card_mask(&deck->cards[2 * i + 1]);
+    }
+    CardMask community_cards = 0;
+    for (uint8_t j = 0; j < num_hole_cards + MAX_NUM_COMMUNITY_CARDS; ++j) {
+        deal->card_indices[j] = get_card_index(&deck->cards[j]);
+        if (j >= num_hole_cards) {
+            community_cards |= get_card_mask(&deck->cards[j]);
+        }
+    }
+    for (uint8_t street = 0; street < NUM_DEALT_STREETS; ++street) {
+        set_dealt_street_equities(deal->equities[street], players_hole_cards, num_players, deck, num_community_cards_by_dealt_street[street], num_equity_trials, random_number_generator);
+    }
+    set_players_strongest_hands(deal->strongest_hands, players_hole_cards, num_players, community_cards);
+    deal->num_players = num_players;
+}
+
+typedef struct {
+    uint8_t* columns[NUM_DEAL_COLUMNS];
+    uint8_t* compressed_columns[NUM_DEAL_COLUMNS];
+    DealsChunkHeader header;
+} DealsChunk;
+
+typedef struct {
+    FILE* file;
+    const char* path;
+    uint64_t seed;
+    uint64_t num_deals;
+    uint64_t num_chunks;
+    uint8_t num_players;
+    uint8_t compression;
+    uint16_t num_equity_trials;
+    // the next chunk to deal, shared by the threads
+    uint64_t next_chunk;
+    // chunks are written in order, each once the previous one is
+    pthread_mutex_t lock;
+    pthread_cond_t chunk_written;
+    uint64_t next_chunk_to_write;
+    bool has_failed;
+    uint64_t num_bytes_written;
+} DealsGenerator;
+
+// Sets the chunk's columns for its i-th deal; the cards column must be zeroed before the chunk's first deal
+void set_deals_chunk_deal(DealsChunk* chunk, uint32_t i, Deal* deal, uint8_t max_num_players) {
+    chunk->columns[NUM_PLAYERS_COLUMN][i] = deal->num_players;
+    uint8_t* codes = chunk->columns[CARDS_COLUMN];
+    uint16_t* equities = (uint16_t*) chunk->columns[EQUITIES_COLUMN] + (uint64_t) i * NUM_DEALT_STREETS * max_num_players;
+    uint32_t* strongest_hands = (uint32_t*) chunk->columns[STRONGEST_HANDS_COLUMN] + (uint64_t) i * max_num_players;
+    uint8_t num_slots = NUM_CARD_SLOTS_PER_DEAL(max_num_players);
+    uint8_t num_hole_cards = deal->num_players * NUM_HOLE_CARDS_PER_PLAYER;
+    for (uint8_t slot = 0; slot < max_num_players * NUM_HOLE_CARDS_PER_PLAYER; ++slot) {
+        set_card_code(codes, (uint64_t) i * num_slots + slot, slot < num_hole_cards ? deal->card_indices[slot] : NO_CARD_CODE);
+    }
+    for (uint8_t j = 0; j < MAX_NUM_COMMUNITY_CARDS; ++j) {
+        set_card_code(codes, (uint64_t) i * num_slots + max_num_players * NUM_HOLE_CARDS_PER_PLAYER + j, deal->card_indices[num_hole_cards + j]);
+    }
+    for (uint8_t street = 0; street < NUM_DEALT_STREETS; ++street) {
+        for (uint8_t j = 0; j < max_num_players; ++j) {
+            equities[street * max_num_players + j] = j < deal->num_players ? (uint16_t) (deal->equities[street][j] * EQUITY_SCALE + 0.5) : 0;
+        }
+    }
+    for (uint8_t j = 0; j < max_num_players; ++j) {
+        strongest_hands[j] = j < deal->num_players ? deal->strongest_hands[j] : 0;
+    }
+}
+
+// Sets the header of a chunk of num_deals deals, and compresses its columns if need be
+bool finish_deals_chunk(DealsChunk* chunk, uint32_t num_deals, uint8_t max_num_players, uint8_t compression) {
+#ifndef USE_ZLIB
+    (void) compression;
+#endif
+    chunk->header.num_deals = num_deals;
+    chunk->header.padding = 0;
+    get_deals_column_raw_sizes(num_deals, max_num_players, chunk->header.column_raw_sizes);
+    for (uint8_t column = 0; column < NUM_DEAL_COLUMNS; ++column) {
+        chunk->header.column_sizes[column] = chunk->header.column_raw_sizes[column];
+#ifdef USE_ZLIB
+        if (compression == ZLIB_COMPRESSION) {
+            uLongf compressed_size = compressBound(chunk->header.column_raw_sizes[column]);
+            if (compress2(chunk->compressed_columns[column], &compressed_size, chunk->columns[column], chunk->header.column_raw_sizes[column], Z_BEST_SPEED) != Z_OK) {
+                return false;
+            }
+            chunk->header.column_sizes[column] = compressed_size;
+        }
+#endif
+    }
+    return true;
+}
+
+void* run_deals_generator_worker(void* arg) {
+    DealsGenerator* generator = arg;
+    DealsChunk chunk;
+    uint64_t column_capacities[NUM_DEAL_COLUMNS];
+    get_deals_column_raw_sizes(NUM_DEALS_PER_CHUNK, generator->num_players, column_capacities);
+    for (uint8_t column = 0; column < NUM_DEAL_COLUMNS; ++column) {
+        chunk.columns[column] = malloc(column_capacities[column]);
+        chunk.compressed_columns[column] = NULL;
+#ifdef USE_ZLIB
+        if (generator->compression == ZLIB_COMPRESSION) {
+            chunk.compressed_columns[column] = malloc(compressBound(column_capacities[column]));
+        }
+#endif
+    }
+
+    while (true) {
+        uint64_t chunk_index = __atomic_fetch_add(&generator->next_chunk, 1, __ATOMIC_RELAXED);
+        if (chunk_index >= generator->num_chunks) {
+            break;
+        }
+        uint64_t first_deal = chunk_index * NUM_DEALS_PER_CHUNK;
+        uint32_t num_deals = generator->num_deals - first_deal < NUM_DEALS_PER_CHUNK ? generator->num_deals - first_deal : NUM_DEALS_PER_CHUNK;
+        uint64_t chunk_seed = generator->seed ^ chunk_index;
+        RandomNumberGenerator random_number_generator = init_random_number_generator(SPLITMIX64, splitmix64(&chunk_seed), 0);
+        Deck deck = get_unshuffled_standard_deck();
+        memset(chunk.columns[CARDS_COLUMN], 0, column_capacities[CARDS_COLUMN]);
+        for (uint32_t i = 0; i < num_deals; ++i) {
+            Deal deal;
+            deal_random_game(&deal, generator->num_players, &deck, generator->num_equity_trials, &random_number_generator);
+            set_deals_chunk_deal(&chunk, i, &deal, generator->num_players);
+        }
+        bool is_set = finish_deals_chunk(&chunk, num_deals, generator->num_players, generator->compression);
+
+        pthread_mutex_lock(&generator->lock);
+        while (generator->next_chunk_to_write != chunk_index) {
+            pthread_cond_wait(&generator->chunk_written, &generator->lock);
+        }
+        if (generator->has_failed == false) {
+            bool is_written = is_set == true && fwrite(&chunk.header, sizeof(DealsChunkHeader), 1, generator->file) == 1;
+            generator->num_bytes_written += sizeof(DealsChunkHeader);
+            for (uint8_t column = 0; column < NUM_DEAL_COLUMNS && is_written == true; ++column) {
+                uint8_t* contents = generator->compression == ZLIB_COMPRESSION ? chunk.compressed_columns[column] : chunk.columns[column];
+                is_written = fwrite(contents, 1, chunk.header.column_sizes[column], generator->file) == chunk.header.column_sizes[column];
+                generator->num_bytes_written += chunk.header.column_sizes[column];
+            }
+            generator->has_failed = is_written == false;
+        }
+        ++(generator->next_chunk_to_write);
+        pthread_cond_broadcast(&generator->chunk_written);
+        pthread_mutex_unlock(&generator->lock);
+    }
+
+    for (uint8_t column = 0; column < NUM_DEAL_COLUMNS; ++column) {
+        free(chunk.columns[column]);
+        free(chunk.compressed_columns[column]);
+    }
+    return NULL;
+}
+
+// Deals --deals games of num_players players across --threads threads into the file at path
+bool generate_deals(const char* path, uint8_t num_players) {
+#ifndef USE_ZLIB
+    if (deals_compression_option == ZLIB_COMPRESSION) {
+        fprintf(stderr, "--compression=zlib needs a build with -DUSE_ZLIB -lz\n");
+        return false;
+    }
+#endif
+    DealsGenerator generator;
+    generator.path = path;
+    generator.num_deals = num_deals_option;
+    generator.num_chunks = (num_deals_option + NUM_DEALS_PER_CHUNK - 1) / NUM_DEALS_PER_CHUNK;
+    generator.num_players = num_players;
+    generator.compression = deals_compression_option;
+    generator.num_equity_trials = num_deal_equity_trials_option;
+    generator.next_chunk = 0;
+    generator.next_chunk_to_write = 0;
+    generator.has_failed = false;
+    pthread_mutex_lock(&main_random_number_generator_lock);
+    generator.seed = get_random_seed(&main_random_number_generator);
+    pthread_mutex_unlock(&main_random_number_generator_lock);
+    if (is_seeded == true) {
+        generator.seed = seed_option;
+    }
+
+    // Written next to the destination and renamed over it, so a reader never maps a half-written file
+    char temporary_path[4096];
+    snprintf(temporary_path, sizeof(temporary_path), "%s.tmp", path);
+    generator.file = fopen(temporary_path, "wb");
+    if (generator.file == NULL) {
+        perror(temporary_path);
+        return false;
+    }
+    // chunks are written in one go, so a large buffer keeps the writes few and big
+    setvbuf(generator.file, NULL, _IOFBF, 1 << 22);
+    DealsFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, DEALS_MAGIC, sizeof(header.magic));
+    header.version = DEALS_VERSION;
+    header.max_num_players = num_players;
+    header.compression = generator.compression;
+    header.num_equity_trials = generator.num_equity_trials;
+    generator.has_failed = fwrite(&header, sizeof(header), 1, generator.file) != 1;
+    generator.num_bytes_written = sizeof(header);
+    pthread_mutex_init(&generator.lock, NULL);
+    pthread_cond_init(&generator.chunk_written, NULL);
+
+    double start = get_time_in_seconds();
+    pthread_t threads[MAX_NUM_THREADS];
+    uint16_t num_workers = num_threads;
+    if (num_workers > generator.num_chunks) {
+        num_workers = generator.num_chunks > 0 ? generator.num_chunks : 1;
+    }
+    // The calling thread is worker 0
+    uint16_t i;
+    for (i = 1; i < num_workers; ++i) {
+        pthread_create(&threads[i], NULL, run_deals_generator_worker, &generator);
+    }
+    run_deals_generator_worker(&generator);
+    for (i = 1; i < num_workers; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    double elapsed = get_time_in_seconds() - start;
+    pthread_mutex_destroy(&generator.lock);
+    pthread_cond_destroy(&generator.chunk_written);
+
+    if (fclose(generator.file) != 0 || generator.has_failed == true || rename(temporary_path, path) != 0) {
+        perror(path);
+        return false;
+    }
+    printf("Wrote %llu deals of %d players to %s in %.2f seconds: %.0f deals/sec, %.1f bytes/deal, %.1f MB/s\n", (unsigned long long) generator.num_deals, num_players, path, elapsed, generator.num_deals / elapsed, (double) generator.num_bytes_written / (generator.num_deals > 0 ? generator.num_deals : 1), generator.num_bytes_written / elapsed / 1e6);
+    return true;
+}
+
+// Iterates over the deals of a file mapped into memory, one chunk at a time
+typedef struct {
+    const uint8_t* contents;
+    size_t size;
+    const DealsFileHeader* header;
+    size_t next_chunk_offset;
+    // copied out of the file, where chunks start anywhere
+    DealsChunkHeader chunk_header;
+    const uint8_t* columns[NUM_DEAL_COLUMNS];
+    // the chunk's columns once decompressed, if the file is compressed
+    uint8_t* decompressed_columns[NUM_DEAL_COLUMNS];
+    uint32_t next_deal;
+    // set when reading stopped at a corrupt chunk rather than at the end of the file
+    bool has_failed;
+} DealsReader;
+
+bool open_deals_reader(DealsReader* reader, const char* path) {
+    memset(reader, 0, sizeof(DealsReader));
+    int file_descriptor = open(path, O_RDONLY);
+    if (file_descriptor < 0) {
+        perror(path);
+        return false;
+    }
+    struct stat file_status;
+    if (fstat(file_descriptor, &file_status) != 0 || (size_t) file_status.st_size < sizeof(DealsFileHeader)) {
+        fprintf(stderr, "%s: not a deals file\n", path);
+        close(file_descriptor);
+        return false;
+    }
+    reader->size = file_status.st_size;
+    void* contents = mmap(NULL, reader->size, PROT_READ, MAP_SHARED, file_descriptor, 0);
+    close(file_descriptor);
+    if (contents == MAP_FAILED) {
+        perror(path);
+        return false;
+    }
+    // the chunks are scanned once from the start
+    madvise(contents, reader->size, MADV_SEQUENTIAL);
+    reader->contents = contents;
+    reader->header = contents;
+    if (memcmp(reader->header->magic, DEALS_MAGIC, sizeof(reader->header->magic)) != 0 || reader->header->version != DEALS_VERSION || reader->header->max_num_players < MIN_NUM_PLAYERS || reader->header->max_num_players > MAX_NUM_PLAYERS) {
+        fprintf(stderr, "%s: not a version %d deals file\n", path, DEALS_VERSION);
+        munmap(contents, reader->size);
+        return false;
+    }
+#ifndef USE_ZLIB
+    if (reader->header->compression == ZLIB_COMPRESSION) {
+        fprintf(stderr, "%s: compressed, and reading it needs a build with -DUSE_ZLIB -lz\n", path);
+        munmap(contents, reader->size);
+        return false;
+    }
+#endif
+    reader->next_chunk_offset = sizeof(DealsFileHeader);
+    return true;
+}
+
+void close_deals_reader(DealsReader* reader) {
+    for (uint8_t column = 0; column < NUM_DEAL_COLUMNS; ++column) {
+        free(reader->decompressed_columns[column]);
+    }
+    munmap((void*) reader->contents, reader->size);
+}
+
+bool read_next_deals_chunk(DealsReader* reader) {
+    if (reader->next_chunk_offset == reader->size) {
+        return false;
+    }
+    reader->has_failed = true;
+    if (reader->size - reader->next_chunk_offset < sizeof(DealsChunkHeader)) {
+        return false;
+    }
+    DealsChunkHeader chunk_header;
+    memcpy(&chunk_header, reader->contents + reader->next_chunk_offset, sizeof(DealsChunkHeader));
+    uint64_t column_raw_sizes[NUM_DEAL_COLUMNS];
+    get_deals_column_raw_sizes(chunk_header.num_deals, reader->header->max_num_players, column_raw_sizes);
+    size_t offset = reader->next_chunk_offset + sizeof(DealsChunkHeader);
+    for (uint8_t column = 0; column < NUM_DEAL_COLUMNS; ++column) {
+        if (chunk_header.num_deals > NUM_DEALS_PER_CHUNK || chunk_header.column_raw_sizes[column] != column_raw_sizes[column] || chunk_header.column_sizes[column] > reader->size - offset) {
+            return false;
+        }
+        reader->columns[column] = reader->contents + offset;
+#ifdef USE_ZLIB
+        if (reader->header->compression == ZLIB_COMPRESSION) {
+            if (reader->decompressed_columns[column] == NULL) {
+                uint64_t column_capacities[NUM_DEAL_COLUMNS];
+                get_deals_column_raw_sizes(NUM_DEALS_PER_CHUNK, reader->header->max_num_players, column_capacities);
+                reader->decompressed_columns[column] = malloc(column_capacities[column]);
+            }
+            uLongf decompressed_size = column_raw_sizes[column];
+            if (uncompress(reader->decompressed_columns[column], &decompressed_size, reader->columns[column], chunk_header.column_sizes[column]) != Z_OK || decompressed_size != column_raw_sizes[column]) {
+                return false;
+            }
+            reader->columns[column] = reader->decompressed_columns[column];
+        }
+        else if (chunk_header.column_sizes[column] != column_raw_sizes[column]) {
+            return false;
+        }
+#else
+        if (chunk_header.column_sizes[column] != column_raw_sizes[column]) {
+            return false;
+        }
+#endif
+        offset += chunk_header.column_sizes[column];
+    }
+    reader->chunk_header = chunk_header;
+    reader->next_chunk_offset = offset;
+    reader->next_deal = 0;
+    reader->has_failed = false;
+    return true;
+}
+
+// Reads the next deal; false at the end of the file, or at a corrupt chunk (see has_failed), such as one with a player
+// count or a card that can't be
+bool read_next_deal(DealsReader* reader, Deal* deal) {
+    while (reader->next_deal == reader->chunk_header.num_deals) {
+        if (read_next_deals_chunk(reader) == false) {
+            return false;
+        }
+    }
+    uint8_t max_num_players = reader->header->max_num_players;
+    uint32_t i = reader->next_deal++;
+    deal->num_players = reader->columns[NUM_PLAYERS_COLUMN][i];
+    if (deal->num_players < MIN_NUM_PLAYERS || deal->num_players > max_num_players) {
+        reader->has_failed = true;
+        return false;
+    }
+    uint8_t num_slots = NUM_CARD_SLOTS_PER_DEAL(max_num_players);
+    uint8_t num_hole_cards = deal->num_players * NUM_HOLE_CARDS_PER_PLAYER;
+    for (uint8_t slot = 0; slot < num_hole_cards; ++slot) {
+        deal->card_indices[slot] = get_card_code(reader->columns[CARDS_COLUMN], (uint64_t) i * num_slots + slot);
+    }
+    for (uint8_t j = 0; j < MAX_NUM_COMMUNITY_CARDS; ++j) {
+        deal->card_indices[num_hole_cards + j] = get_card_code(reader->columns[CARDS_COLUMN], (uint64_t) i * num_slots + max_num_players * NUM_HOLE_CARDS_PER_PLAYER + j);
+    }
+    for (uint8_t slot = 0; slot < num_hole_cards + MAX_NUM_COMMUNITY_CARDS; ++slot) {
+        if (deal->card_indices[slot] >= STANDARD_DECK_SIZE) {
+            reader->has_failed = true;
+            return false;
+        }
+    }
+    // the columns start anywhere in the file, so their values are copied out rather than read in place
+    const uint8_t* equities = reader->columns[EQUITIES_COLUMN] + (uint64_t) i * NUM_DEALT_STREETS * max_num_players * sizeof(uint16_t);
+    for (uint8_t street = 0; street < NUM_DEALT_STREETS; ++street) {
+        for (uint8_t j = 0; j < deal->num_players; ++j) {
+            uint16_t equity;
+            memcpy(&equity, equities + (street * max_num_players + j) * sizeof(uint16_t), sizeof(uint16_t));
+            deal->equities[street][j] = (double) equity / EQUITY_SCALE;
+        }
+    }
+    memcpy(deal->strongest_hands, reader->columns[STRONGEST_HANDS_COLUMN] + (uint64_t) i * max_num_players * sizeof(uint32_t), deal->num_players * sizeof(uint32_t));
+    return true;
+}
+
+// Reads every deal of the file, checks that the final scores are the evaluator's, and shows the averages
+bool scan_deals(const char* path) {
+    DealsReader reader;
+    if (open_deals_reader(&reader, path) == false) {
+        return false;
+    }
+    double start = get_time_in_seconds();
+    Deal deal;
+    uint64_t num_deals = 0;
+    uint64_t num_wrong_deals = 0;
+    uint64_t num_deals_by_num_players[MAX_NUM_PLAYERS + 1] = {0};
+    double first_player_equity_sums[NUM_DEALT_STREETS] = {0};
+    uint64_t winning_hand_rank_counts[NUM_HAND_RANKS] = {0};
+    while (read_next_deal(&reader, &deal) == true) {
+        ++num_deals;
+        ++num_deals_by_num_players[deal.num_players];
+        uint8_t num_hole_cards = deal.num_players * NUM_HOLE_CARDS_PER_PLAYER;
+        CardMask community_cards = 0;
+        for (uint8_t j = 0; j < MAX_NUM_COMMUNITY_CARDS; ++j) {
+            community_cards |= (CardMask) 1 << deal.card_indices[num_hole_cards + j];
+        }
+        CardMask dealt_cards = community_cards;
+        uint32_t strongest_hand = 0;
+        bool is_right = true;
+        for (uint8_t j = 0; j < deal.num_players; ++j) {
+            CardMask hole_cards = ((CardMask) 1 << deal.card_indices[2 * j]) | ((CardMask) 1 << deal.card_indices[2 * j + 1]);
+            is_right = is_right && (dealt_cards & hole_cards) == 0 && deal.strongest_hands[j] / HAND_RANK_WEIGHT < NUM_HAND_RANKS && get_player_strongest_hand(hole_cards, community_cards) == deal.strongest_hands[j];
+            dealt_cards |= hole_cards;
+            if (deal.strongest_hands[j] > strongest_hand) {
+                strongest_hand = deal.strongest_hands[j];
+            }
+        }
+        for (uint8_t street = 0; street < NUM_DEALT_STREETS; ++street) {
+            first_player_equity_sums[street] += deal.equities[street][0];
+        }
+        // the scores of a wrong deal can be anything, so only the right deals' winning hands are counted
+        if (is_right == false || get_card_mask_count(dealt_cards) != num_hole_cards + MAX_NUM_COMMUNITY_CARDS) {
+            ++num_wrong_deals;
+            continue;
+        }
+        ++winning_hand_rank_counts[strongest_hand / HAND_RANK_WEIGHT];
+    }
+    double elapsed = get_time_in_seconds() - start;
+    bool has_failed = reader.has_failed;
+    uint16_t num_equity_trials = reader.header->num_equity_trials;
+    close_deals_reader(&reader);
+    if (has_failed == true) {
+        fprintf(stderr, "%s: corrupt chunk after %llu deals\n", path, (unsigned long long) num_deals);
+        return false;
+    }
+
+    printf("%llu deals (%llu with wrong cards or scores, equities from %d board completions before the turn) read in %.2f seconds: %.0f deals/sec\n", (unsigned long long) num_deals, (unsigned long long) num_wrong_deals, num_equity_trials, elapsed, num_deals / elapsed);
+    for (uint8_t num_players = MIN_NUM_PLAYERS; num_players <= MAX_NUM_PLAYERS; ++num_players) {
+        if (num_deals_by_num_players[num_players] > 0) {
+            printf("%d players: %llu deals\n", num_players, (unsigned long long) num_deals_by_num_players[num_players]);
+        }
+    }
+    if (num_deals > 0) {
+        printf("First player's mean equity: preflop %.3f%%, flop %.3f%%, turn %.3f%%, river %.3f%%\n", first_player_equity_sums[0] / num_deals * 100, first_player_equity_sums[1] / num_deals * 100, first_player_equity_sums[2] / num_deals * 100, first_player_equity_sums[3] / num_deals * 100);
+    }
+    if (num_deals > num_wrong_deals) {
+        for (uint8_t hand_rank = NOTHING; hand_rank < NUM_HAND_RANKS; ++hand_rank) {
+            printf("  won with %-16s %8.3f%%\n", hand_rank_names[hand_rank], (double) winning_hand_rank_counts[hand_rank] / (num_deals - num_wrong_deals) * 100);
+        }
+    }
+    return num_wrong_deals == 0;
+}
+
+// #############################################
+// Preflop equity database
+// #############################################
+
+// The 169 starting hands are the cells of a 13x13 grid: pairs on the diagonal, suited hands at
+// [high rank][low rank] and offsuit hands at [low rank][high rank]
+#define NUM_STARTING_HANDS (NUM_CARD_RANKS * NUM_CARD_RANKS)
+#define NUM_PLAYER_COUNTS (MAX_NUM_PLAYERS - MIN_NUM_PLAYERS + 1)
+
+#define PREFLOP_EQUITY_DATABASE_MAGIC "THPFEQDB"
+#define PREFLOP_EQUITY_DATABASE_VERSION 1
+#define DEFAULT_PREFLOP_EQUITY_DATABASE_PATH "preflop_equities.bin"
+
+// The file is a header followed by the entries of every starting hand for every player count, in native byte order
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t num_starting_hands;
+    uint8_t min_num_players;
+    uint8_t max_num_players;
+    uint8_t padding[6];
+} PreflopEquityDatabaseHeader;
+
+typedef struct {
+    double win_equity;
+    double tie_equity;
+    double standard_error;
+    uint64_t num_trials;
+} PreflopEquityDatabaseEntry;
+
+const char* preflop_equity_database_path = DEFAULT_PREFLOP_EQUITY_DATABASE_PATH;
+const PreflopEquityDatabaseEntry* preflop_equity_database = NULL;
+
+const char card_rank_to_range_notation[NUM_CARD_RANKS] = { '2', '3', '4', '5', '6', '7', '8', '9', 'T', 'J', 'Q', 'K', 'A' };
+
+// Reads a rank written as in range notation ("T" or "10" for ten), advancing the text past it; -1 if there is none
+int8_t parse_card_rank(const char** text) {
+    if ((*text)[0] == '1' && (*text)[1] == '0') {
+        *text += 2;
+        return TEN;
+    }
+    for (uint8_t rank = MIN_CARD_RANK; rank <= MAX_CARD_RANK; ++rank) {
+        char notation = card_rank_to_range_notation[rank];
+        if ((*text)[0] == notation || (notation >= 'A' && (*text)[0] == notation + ('a' - 'A'))) {
+            ++(*text);
+            return rank;
+        }
+    }
+    return -1;
+}
+
+uint8_t get_starting_hand_index(Card* hole_cards) {
+    uint8_t high_rank = hole_cards[0].rank > hole_cards[1].rank ? hole_cards[0].rank : hole_cards[1].rank;
+    uint8_t low_rank = hole_cards[0].rank > hole_cards[1].rank ? hole_cards[1].rank : hole_cards[0].rank;
+    if (hole_cards[0].suit == hole_cards[1].suit) {
+        return high_rank * NUM_CARD_RANKS + low_rank;
+    }
+    return low_rank * NUM_CARD_RANKS + high_rank;
+}
+
+// Hole cards of the starting hand, clubs first
+HoleCards get_starting_hand_hole_cards(uint8_t starting_hand_index) {
+    HoleCards res = init_hole_cards();
+    uint8_t row = starting_hand_index / NUM_CARD_RANKS;
+    uint8_t column = starting_hand_index % NUM_CARD_RANKS;
+    res.cards[0].rank = row > column ? row : column;
+    res.cards[0].suit = CLUBS;
+    res.cards[1].rank = row > column ? column : row;
+    res.cards[1].suit = row > column ? CLUBS : DIAMONDS;
+    res.count = NUM_HOLE_CARDS_PER_PLAYER;
+    res.mask = get_card_mask(&res.cards[0]) | get_card_mask(&res.cards[1]);
+    return res;
+}
+
+// e.g. "AA", "AKs", "T9o"
+void get_starting_hand_name(uint8_t starting_hand_index, char* name) {
+    uint8_t row = starting_hand_index / NUM_CARD_RANKS;
+    uint8_t column = starting_hand_index % NUM_CARD_RANKS;
+    name[0] = card_rank_to_range_notation[row > column ? row : column];
+    name[1] = card_rank_to_range_notation[row > column ? column : row];
+    name[2] = row == column ? '\0' : (row > column ? 's' : 'o');
+    name[3] = '\0';
+}
+
+// Index of a starting hand named like "AKs", "AKo" or "AA", or -1
+int16_t parse_starting_hand(const char* name) {
+    int8_t first_rank = parse_card_rank(&name);
+    int8_t second_rank = first_rank < 0 ? -1 : parse_card_rank(&name);
+    if (second_rank < 0) {
+        return -1;
+    }
+    uint8_t high_rank = first_rank > second_rank ? first_rank : second_rank;
+    uint8_t low_rank = first_rank > second_rank ? second_rank : first_rank;
+    if (high_rank == low_rank) {
+        return name[0] == '\0' ? high_rank * NUM_CARD_RANKS + low_rank : -1;
+    }
+    if ((name[0] == 's' || name[0] == 'S') && name[1] == '\0') {
+        return high_rank * NUM_CARD_RANKS + low_rank;
+    }
+    if ((name[0] == 'o' || name[0] == 'O') && name[1] == '\0') {
+        return low_rank * NUM_CARD_RANKS + high_rank;
+    }
+    return -1;
+}
+
+// Maps the database file into memory; lookups fall back to simulating if it is missing or not of this version
+void init_preflop_equity_database() {
+    int file_descriptor = open(preflop_equity_database_path, O_RDONLY);
+    if (file_descriptor < 0) {
+        return;
+    }
+    size_t expected_size = sizeof(PreflopEquityDatabaseHeader) + NUM_STARTING_HANDS * NUM_PLAYER_COUNTS * sizeof(PreflopEquityDatabaseEntry);
+    struct stat file_status;
+    if (fstat(file_descriptor, &file_status) != 0 || (size_t) file_status.st_size != expected_size) {
+        fprintf(stderr, "Ignoring %s: unexpected size\n", preflop_equity_database_path);
+        close(file_descriptor);
+        return;
+    }
+    void* contents = mmap(NULL, expected_size, PROT_READ, MAP_SHARED, file_descriptor, 0);
+    close(file_descriptor);
+    if (contents == MAP_FAILED) {
+        return;
+    }
+    const PreflopEquityDatabaseHeader* header = contents;
+    if (memcmp(header->magic, PREFLOP_EQUITY_DATABASE_MAGIC, sizeof(header->magic)) != 0 || header->version != PREFLOP_EQUITY_DATABASE_VERSION || header->num_starting_hands != NUM_STARTING_HANDS || header->min_num_players != MIN_NUM_PLAYERS || header->max_num_players != MAX_NUM_PLAYERS) {
+        fprintf(stderr, "Ignoring %s: not a version %d preflop equity database\n", preflop_equity_database_path, PREFLOP_EQUITY_DATABASE_VERSION);
+        munmap(contents, expected_size);
+        return;
+    }
+    preflop_equity_database = (const PreflopEquityDatabaseEntry*) (header + 1);
+}
+
+// Equity of the hole cards against num_players - 1 opponents with unknown hole cards, or NULL without a database
+const PreflopEquityDatabaseEntry* get_preflop_equity(Card* hole_cards, uint8_t num_players) {
+    if (preflop_equity_database == NULL) {
+        return NULL;
+    }
+    return &preflop_equity_database[get_starting_hand_index(hole_cards) * NUM_PLAYER_COUNTS + num_players - MIN_NUM_PLAYERS];
+}
+
+// An entry is as good an answer as simulating the spot when it meets the stopping rule's target standard error, or has
+// at least as many trials as the simulation could run
+bool does_preflop_equity_meet_stopping_rule(const PreflopEquityDatabaseEntry* entry, StoppingRule* stopping_rule) {
+    if (stopping_rule->target_standard_error > 0 && entry->standard_error <= stopping_rule->target_standard_error) {
+        return true;
+    }
+    return entry->num_trials >= stopping_rule->max_num_trials;
+}
+
+// Simulates every starting hand against every number of opponents, and writes the database file
+bool generate_preflop_equity_database() {
+    static PreflopEquityDatabaseEntry entries[NUM_STARTING_HANDS * NUM_PLAYER_COUNTS];
+    for (uint8_t starting_hand_index = 0; starting_hand_index < NUM_STARTING_HANDS; ++starting_hand_index) {
+        char name[4];
+        get_starting_hand_name(starting_hand_index, name);
+        fprintf(stderr, "\r%-3s (%d/%d)", name, starting_hand_index + 1, NUM_STARTING_HANDS);
+        for (uint8_t num_players = MIN_NUM_PLAYERS; num_players <= MAX_NUM_PLAYERS; ++num_players) {
+            Game game = init_game(&num_players);
+            game.players.hole_cards[0] = get_starting_hand_hole_cards(starting_hand_index);
+            WinningProbabilityDistribution winning_probability_distribution;
+            set_winning_probability_distribution(&game, &winning_probability_distribution, &stopping_rule_option);
+
+            PreflopEquityDatabaseEntry* entry = &entries[starting_hand_index * NUM_PLAYER_COUNTS + num_players - MIN_NUM_PLAYERS];
+            entry->win_equity = winning_probability_distribution.equities[0] - winning_probability_distribution.tie_equities[0];
+            entry->tie_equity = winning_probability_distribution.tie_equities[0];
+            entry->standard_error = winning_probability_distribution.standard_errors[0];
+            entry->num_trials = winning_probability_distribution.num_trials;
+        }
+    }
+    fprintf(stderr, "\n");
+
+    PreflopEquityDatabaseHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, PREFLOP_EQUITY_DATABASE_MAGIC, sizeof(header.magic));
+    header.version = PREFLOP_EQUITY_DATABASE_VERSION;
+    header.num_starting_hands = NUM_STARTING_HANDS;
+    header.min_num_players = MIN_NUM_PLAYERS;
+    header.max_num_players = MAX_NUM_PLAYERS;
+
+    // Written next to the destination and renamed over it, so a reader never maps a half-written file
+    char temporary_path[4096];
+    snprintf(temporary_path, sizeof(temporary_path), "%s.tmp", preflop_equity_database_path);
+    FILE* file = fopen(temporary_path, "wb");
+    if (file == NULL) {
+        perror(temporary_path);
+        return false;
+    }
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(entries, sizeof(entries), 1, file) == 1;
+    if (fclose(file) != 0 || written == false || rename(temporary_path, preflop_equity_database_path) != 0) {
+        perror(preflop_equity_database_path);
+        return false;
+    }
+    fprintf(stderr, "Wrote %s\n", preflop_equity_database_path);
+    return true;
+}
+
+void display_preflop_equity(const char* starting_hand_name, uint8_t num_players) {
+    int16_t starting_hand_index = parse_starting_hand(starting_hand_name);
+    if (starting_hand_index < 0) {
+        fprintf(stderr, "Not a starting hand: %s\n", starting_hand_name);
+        return;
+    }
+    HoleCards hole_cards = get_starting_hand_hole_cards(starting_hand_index);
+    const PreflopEquityDatabaseEntry* entry = get_preflop_equity(hole_cards.cards, num_players);
+    if (entry == NULL) {
+        fprintf(stderr, "No preflop equity database at %s (create it with the generate-preflop-database mode)\n", preflop_equity_database_path);
+        return;
+    }
+    printf("%s against %d opponents: equity %.2f%% (win %.2f%%, tie %.2f%%) +/- %.2f%%, %llu trials\n", starting_hand_name, num_players - 1, (entry->win_equity + entry->tie_equity) * 100, entry->win_equity * 100, entry->tie_equity * 100, entry->standard_error * 100, (unsigned long long) entry->num_trials);
+}
+
+// #############################################
+// Range notation
+// #############################################
+
+// Reads cards like "Ah Kd", "AhKd" or "10s 9s", separated by spaces or commas; returns how many, or -1 if the text is not a list of at most max_num_cards distinct cards
+int8_t parse_cards(const char* text, Card* cards, uint8_t max_num_cards) {
+    int8_t res = 0;
+    CardMask seen_cards = 0;
+    while (true) {
+        while (*text == ' ' || *text == ',' || *text == '\t' || *text == '\n' || *text == '\r') {
+            ++text;
+        }
+        if (*text == '\0') {
+            return res;
+        }
+        int8_t rank = parse_card_rank(&text);
+        if (rank < 0 || res == max_num_cards) {
+            return -1;
+        }
+        Card card;
+        card.rank = rank;
+        if (*text == 'c' || *text == 'C') {
+            card.suit = CLUBS;
+        }
+        else if (*text == 'd' || *text == 'D') {
+            card.suit = DIAMONDS;
+        }
+        else if (*text == 'h' || *text == 'H') {
+            card.suit = HEARTS;
+        }
+        else if (*text == 's' || *text == 'S') {
+            card.suit = SPADES;
+        }
+        else {
+            return -1;
+        }
+        ++text;
+        if ((seen_cards & get_card_mask(&card)) != 0) {
+            return -1;
+        }
+        seen_cards |= get_card_mask(&card);
+        cards[res++] = card;
+    }
+}
+
+// The starting hands from the best to the worst equity against one random hand, for ranges like "top 15%"
+const char* starting_hands_by_equity[NUM_STARTING_HANDS] = {
+    "AA", "KK", "QQ", "JJ", "TT", "99", "88", "AKs", "77", "AQs", "AJs", "AKo", "ATs",
+    "AQo", "AJo", "KQs", "66", "A9s", "ATo", "KJs", "A8s", "KTs", "KQo", "A7s", "A9o", "KJo",
+    "55", "QJs", "K9s", "A5s", "A6s", "A8o", "KTo", "QTs", "A4s", "A7o", "K8s", "A3s", "QJo",
+    "K9o", "A6o", "A5o", "Q9s", "JTs", "K7s", "A2s", "QTo", "44", "A4o", "K6s", "K8o", "Q8s",
+    "A3o", "K5s", "J9s", "Q9o", "JTo", "K7o", "A2o", "K4s", "Q7s", "K6o", "K3s", "J8s", "T9s",
+    "33", "Q6s", "Q8o", "K5o", "J9o", "K2s", "Q5s", "T8s", "K4o", "J7s", "Q4s", "Q7o", "T9o",
+    "J8o", "K3o", "Q3s", "Q6o", "98s", "T7s", "J6s", "K2o", "22", "Q2s", "Q5o", "J5s", "T8o",
+    "J7o", "Q4o", "97s", "J4s", "T6s", "J3s", "Q3o", "98o", "87s", "T7o", "J6o", "96s", "J2s",
+    "Q2o", "T5s", "J5o", "T4s", "97o", "86s", "J4o", "T6o", "T3s", "95s", "76s", "J3o", "87o",
+    "T2s", "85s", "96o", "J2o", "T5o", "94s", "75s", "T4o", "93s", "86o", "65s", "84s", "95o",
+    "T3o", "92s", "76o", "74s", "T2o", "54s", "85o", "64s", "83s", "94o", "75o", "82s", "73s",
+    "93o", "65o", "53s", "63s", "84o", "92o", "43s", "74o", "54o", "72s", "64o", "52s", "62s",
+    "83o", "42s", "82o", "73o", "53o", "63o", "32s", "43o", "72o", "52o", "62o", "42o", "32o"
+};
+
+// suitedness of the starting hands in a range:
+#define ANY_SUITEDNESS 0
+#define SUITED_ONLY 1
+#define OFFSUIT_ONLY 2
+
+void add_starting_hand_to_range(Range* range, uint8_t high_rank, uint8_t low_rank, uint8_t suitedness, double weight) {
+    for (uint8_t high_suit = MIN_SUIT; high_suit <= MAX_SUIT; ++high_suit) {
+        for (uint8_t low_suit = MIN_SUIT; low_suit <= MAX_SUIT; ++low_suit) {
+            if ((high_rank == low_rank && high_suit >= low_suit) || (suitedness == SUITED_ONLY && high_suit != low_suit) || (suitedness == OFFSUIT_ONLY && high_suit == low_suit)) {
+                continue;
+            }
+            Card high_card = { high_rank, high_suit };
+            Card low_card = { low_rank, low_suit };
+            range->weights[get_hole_cards_combination_index(get_card_mask(&high_card) | get_card_mask(&low_card))] = weight;
+        }
+    }
+}
+
+// Adds the best starting hands until they make up at least the percentage of all the combinations
+void add_top_starting_hands_to_range(Range* range, double percentage, double weight) {
+    uint16_t num_combinations = 0;
+    for (uint8_t i = 0; i < NUM_STARTING_HANDS && num_combinations < percentage / 100 * NUM_HOLE_CARDS_COMBINATIONS; ++i) {
+        uint8_t starting_hand_index = parse_starting_hand(starting_hands_by_equity[i]);
+        uint8_t row = starting_hand_index / NUM_CARD_RANKS;
+        uint8_t column = starting_hand_index % NUM_CARD_RANKS;
+        if (row == column) {
+            add_starting_hand_to_range(range, row, column, ANY_SUITEDNESS, weight);
+            num_combinations += 6;
+        }
+        else if (row > column) {
+            add_starting_hand_to_range(range, row, column, SUITED_ONLY, weight);
+            num_combinations += 4;
+        }
+        else {
+            add_starting_hand_to_range(range, column, row, OFFSUIT_ONLY, weight);
+            num_combinations += 12;
+        }
+    }
+}
+
+// e.g. "AK", "AKs" or "AKo", in either rank order
+bool parse_starting_hands(const char** text, uint8_t* high_rank, uint8_t* low_rank, uint8_t* suitedness) {
+    int8_t first_rank = parse_card_rank(text);
+    int8_t second_rank = first_rank < 0 ? -1 : parse_card_rank(text);
+    if (second_rank < 0) {
+        return false;
+    }
+    *high_rank = first_rank > second_rank ? first_rank : second_rank;
+    *low_rank = first_rank > second_rank ? second_rank : first_rank;
+    *suitedness = ANY_SUITEDNESS;
+    if (**text == 's' || **text == 'S') {
+        *suitedness = SUITED_ONLY;
+        ++(*text);
+    }
+    else if (**text == 'o' || **text == 'O') {
+        *suitedness = OFFSUIT_ONLY;
+        ++(*text);
+    }
+    return *high_rank != *low_rank || *suitedness == ANY_SUITEDNESS;
+}
+
+// Adds one part of a range: "top 15%" (or "15%"), "AhKh", "AKs", "AK", "QQ+", "ATs+", "22-55" or "A2s-A5s",
+// optionally weighted like "AKs:0.5"
+bool add_range_part(Range* range, char* part) {
+    double weight = 1;
+    char* weight_text = strchr(part, ':');
+    if (weight_text != NULL) {
+        *weight_text = '\0';
+        char* end;
+        weight = strtod(weight_text + 1, &end);
+        if (end == weight_text + 1 || *end != '\0' || weight < 0) {
+            return false;
+        }
+    }
+    if (strncasecmp(part, "top", 3) == 0 || (strlen(part) > 0 && part[strlen(part) - 1] == '%')) {
+        const char* percentage_text = strncasecmp(part, "top", 3) == 0 ? part + 3 : part;
+        char* end;
+        double percentage = strtod(percentage_text, &end);
+        if (end == percentage_text || strcmp(end, "%") != 0 || percentage < 0 || percentage > 100) {
+            return false;
+        }
+        add_top_starting_hands_to_range(range, percentage, weight);
+        return true;
+    }
+    Card cards[NUM_HOLE_CARDS_PER_PLAYER];
+    if (parse_cards(part, cards, NUM_HOLE_CARDS_PER_PLAYER) == NUM_HOLE_CARDS_PER_PLAYER) {
+        range->weights[get_hole_cards_combination_index(get_card_mask(&cards[0]) | get_card_mask(&cards[1]))] = weight;
+        return true;
+    }
+
+    const char* text = part;
+    uint8_t high_rank, low_rank, suitedness;
+    if (parse_starting_hands(&text, &high_rank, &low_rank, &suitedness) == false) {
+        return false;
+    }
+    if (*text == '\0') {
+        add_starting_hand_to_range(range, high_rank, low_rank, suitedness, weight);
+        return true;
+    }
+    // "QQ+" goes up to AA, "ATs+" up to AKs
+    if (strcmp(text, "+") == 0) {
+        uint8_t max_rank = high_rank == low_rank ? MAX_CARD_RANK : high_rank - 1;
+        for (uint8_t rank = low_rank; rank <= max_rank; ++rank) {
+            add_starting_hand_to_range(range, high_rank == low_rank ? rank : high_rank, rank, suitedness, weight);
+        }
+        return true;
+    }
+    if (*text != '-') {
+        return false;
+    }
+    ++text;
+    uint8_t last_high_rank, last_low_rank, last_suitedness;
+    if (parse_starting_hands(&text, &last_high_rank, &last_low_rank, &last_suitedness) == false || *text != '\0' || last_suitedness != suitedness) {
+        return false;
+    }
+    // "22-55" are pairs, "A2s-A5s" share the high card
+    if (high_rank == low_rank && last_high_rank == last_low_rank) {
+        uint8_t min_rank = low_rank < last_low_rank ? low_rank : last_low_rank;
+        uint8_t max_rank = low_rank < last_low_rank ? last_low_rank : low_rank;
+        for (uint8_t rank = min_rank; rank <= max_rank; ++rank) {
+            add_starting_hand_to_range(range, rank, rank, ANY_SUITEDNESS, weight);
+        }
+        return true;
+    }
+    if (high_rank != last_high_rank || high_rank == low_rank || last_high_rank == last_low_rank) {
+        return false;
+    }
+    uint8_t min_rank = low_rank < last_low_rank ? low_rank : last_low_rank;
+    uint8_t max_rank = low_rank < last_low_rank ? last_low_rank : low_rank;
+    for (uint8_t rank = min_rank; rank <= max_rank; ++rank) {
+        add_starting_hand_to_range(range, high_rank, rank, suitedness, weight);
+    }
+    return true;
+}
+
+// Parses a comma separated range like "QQ+, AKs, top 5%"; later parts override the weights of earlier ones
+bool parse_range(const char* text, Range* range) {
+    init_range(range);
+    char part[64];
+    while (*text != '\0') {
+        while (*text == ' ' || *text == ',') {
+            ++text;
+        }
+        const char* end = text;
+        while (*end != '\0' && *end != ',') {
+            ++end;
+        }
+        size_t length = end - text;
+        while (length > 0 && text[length - 1] == ' ') {
+            --length;
+        }
+        if (length == 0) {
+            break;
+        }
+        if (length >= sizeof(part)) {
+            return false;
+        }
+        memcpy(part, text, length);
+        part[length] = '\0';
+        if (add_range_part(range, part) == false) {
+            return false;
+        }
+        text = end;
+    }
+    return true;
+}
+
+void display_winning_probability_distribution_method(WinningProbabilityDistribution* winning_probability_distribution, uint8_t num_players) {
+    if (winning_probability_distribution->is_cached == true) {
+        printf("(cached) ");
+    }
+    if (winning_probability_distribution->method == EXACT_ENUMERATION) {
+        printf("(exact: %llu board completions)\n", (unsigned long long) winning_probability_distribution->num_trials);
+    }
+    else {
+        printf("(Monte Carlo: %llu trials, standard errors:", (unsigned long long) winning_probability_distribution->num_trials);
+        for (uint8_t i = 0; i < num_players; ++i) {
+            printf(" %.2f%%", winning_probability_distribution->standard_errors[i] * 100);
+        }
+        printf(")\n");
+    }
+}
+
+// Every player's chances of ending up with each hand rank, and the winning hand's
+void display_hand_rank_distribution(SimulationTotals* totals) {
+    printf("Hand rank       ");
+    for (uint8_t i = 0; i < totals->num_players; ++i) {
+        printf("  Player %-2d", i + 1);
+    }
+    printf("     Winner\n");
+    for (uint8_t hand_rank = NOTHING; hand_rank < NUM_HAND_RANKS; ++hand_rank) {
+        printf("%-16s", hand_rank_names[hand_rank]);
+        for (uint8_t i = 0; i < totals->num_players; ++i) {
+            printf("  %8.3f%%", (double) totals->hand_rank_counts[i][hand_rank] / totals->num_trials * 100);
+        }
+        printf("  %8.3f%%\n", (double) totals->winning_hand_rank_counts[hand_rank] / totals->num_trials * 100);
+    }
+}
+
+void display_street(Game* game, RunoutTable* runout_table) {
+    WinningProbabilityDistribution winning_probability_distribution;
+    uint64_t num_reused_runouts;
+    set_street_winning_probability_distribution(game, runout_table, &winning_probability_distribution, &stopping_rule_option, &num_reused_runouts);
+    display_table_for_tv_watcher(&game->players, &game->community_cards, winning_probability_distribution.equities);
+    if (num_reused_runouts > 0) {
+        printf("(%llu runouts of the earlier streets reused) ", (unsigned long long) num_reused_runouts);
+    }
+    display_winning_probability_distribution_method(&winning_probability_distribution, game->players.count);
+}
+
+void simulate_game(uint8_t num_players) {
+
+    Game game = init_game(&num_players);
+    game.deck = get_shuffled_deck(&original_unshuffled_standard_deck, &main_random_number_generator);
+    RunoutTable runout_table = init_runout_table(num_players);
+    
+    deal_hole_cards(&game.players, &game.deck);
+
+    display_street(&game, &runout_table);
+
+    deal_the_flop(&game.community_cards, &game.deck, &game.burned_cards);
+
+    display_street(&game, &runout_table);
+
+    deal_the_turn(&game.community_cards, &game.deck, &game.burned_cards);
+
+    display_street(&game, &runout_table);
+
+    deal_the_river(&game.community_cards, &game.deck, &game.burned_cards);
+
+    display_street(&game, &runout_table);
+
+    free_runout_table(&runout_table);
+}
+
+#define NUM_EVALUATOR_COMPARISON_HANDS 100000
+
+// A/B check of the brute force evaluator against the lookup-table one: agreement, then throughput
+void compare_evaluators(uint8_t num_players) {
+    static CardMask hole_cards[NUM_EVALUATOR_COMPARISON_HANDS];
+    static CardMask community_cards[NUM_EVALUATOR_COMPARISON_HANDS];
+    uint32_t i;
+    for (i = 0; i < NUM_EVALUATOR_COMPARISON_HANDS; ++i) {
+        Deck deck = get_shuffled_deck(&original_unshuffled_standard_deck, &main_random_number_generator);
+        HoleCards hand_hole_cards = init_hole_cards();
+        CommunityCards hand_community_cards = init_community_cards();
+        for (uint8_t j = 0; j < NUM_HOLE_CARDS_PER_PLAYER; ++j) {
+            deal_card(&deck, hand_hole_cards.cards, &hand_hole_cards.count, &hand_hole_cards.mask);
+        }
+        for (uint8_t j = 0; j < MAX_NUM_COMMUNITY_CARDS; ++j) {
+            deal_community_card(&hand_community_cards, &deck);
+        }
+        hole_cards[i] = hand_hole_cards.mask;
+        community_cards[i] = hand_community_cards.mask;
+    }
+
+    uint32_t num_mismatches = 0;
+    for (i = 0; i < NUM_EVALUATOR_COMPARISON_HANDS; ++i) {
+        uint32_t brute_force_strength = get_player_strongest_hand_by_brute_force(hole_cards[i], community_cards[i]);
+        uint32_t lookup_table_strength = get_player_strongest_hand_from_lookup_tables(hole_cards[i], community_cards[i]);
+        if (brute_force_strength != lookup_table_strength) {
+            if (num_mismatches == 0) {
+                printf("Mismatch: ");
+                Card cards[MAX_NUM_COMMUNITY_CARDS + NUM_HOLE_CARDS_PER_PLAYER];
+                uint8_t num_cards = get_cards_from_card_mask(hole_cards[i] | community_cards[i], cards);
+                print_cards(cards, &num_cards);
+                printf(" (brute force: %u, lookup tables: %u)\n", brute_force_strength, lookup_table_strength);
+            }
+            ++num_mismatches;
+        }
+    }
+    printf("%u mismatches in %d random 7-card hands\n", num_mismatches, NUM_EVALUATOR_COMPARISON_HANDS);
+
+    const char* evaluator_names[] = { "brute force", "lookup tables" };
+    uint32_t checksum = 0;
+    for (uint8_t evaluator = BRUTE_FORCE_EVALUATOR; evaluator <= LOOKUP_TABLE_EVALUATOR; ++evaluator) {
+        hand_evaluator = evaluator;
+        double start = get_time_in_seconds();
+        for (i = 0; i < NUM_EVALUATOR_COMPARISON_HANDS; ++i) {
+            checksum += get_player_strongest_hand(hole_cards[i], community_cards[i]);
+        }
+        double elapsed = get_time_in_seconds() - start;
+        printf("%-14s %12.0f hands/sec\n", evaluator_names[evaluator], NUM_EVALUATOR_COMPARISON_HANDS / elapsed);
+    }
+
+    Game game = init_game(&num_players);
+    game.deck = get_shuffled_deck(&original_unshuffled_standard_deck, &main_random_number_generator);
+    deal_hole_cards(&game.players, &game.deck);
+    WinningProbabilityDistribution winning_probability_distribution;
+    for (uint8_t evaluator = BRUTE_FORCE_EVALUATOR; evaluator <= LOOKUP_TABLE_EVALUATOR; ++evaluator) {
+        hand_evaluator = evaluator;
+        double start = get_time_in_seconds();
+        set_winning_probability_distribution(&game, &winning_probability_distribution, &stopping_rule_option);
+        double elapsed = get_time_in_seconds() - start;
+        printf("%-14s %12.0f trials/sec, equities:", evaluator_names[evaluator], winning_probability_distribution.num_trials / elapsed);
+        for (i = 0; i < game.players.count; ++i) {
+            printf(" %.4f", winning_probability_distribution.equities[i]);
+        }
+        printf("\n");
+    }
+    printf("(checksum %u)\n", checksum);
+}
+
+// Hole cards typed by the user, or no cards at the end of the input
+HoleCards get_hole_cards_from_input() {
+    HoleCards res = init_hole_cards();
+    char line[256];
+    while (true) {
+        printf("\nEnter your hole cards (e.g. Ah Kd): ");
+        if (fgets(line, sizeof(line), stdin) == NULL) {
+            return res;
+        }
+        if (parse_cards(line, res.cards, NUM_HOLE_CARDS_PER_PLAYER) == NUM_HOLE_CARDS_PER_PLAYER) {
+            res.count = NUM_HOLE_CARDS_PER_PLAYER;
+            res.mask = get_card_mask(&res.cards[0]) | get_card_mask(&res.cards[1]);
+            return res;
+        }
+        printf("Expected 2 different cards.");
+    }
+}
+
+// Community cards typed by the user (none, the flop, the turn or the river), which can't be among the user's hole cards
+CommunityCards get_community_cards_from_input(CardMask users_hole_cards) {
+    CommunityCards res = init_community_cards();
+    char line[256];
+    while (true) {
+        printf("Enter the community cards (nothing before the flop): ");
+        if (fgets(line, sizeof(line), stdin) == NULL) {
+            return res;
+        }
+        int8_t num_cards = parse_cards(line, res.cards, MAX_NUM_COMMUNITY_CARDS);
+        if (num_cards == 0 || num_cards == 3 || num_cards == 4 || num_cards == MAX_NUM_COMMUNITY_CARDS) {
+            res.count = num_cards;
+            res.mask = 0;
+            for (uint8_t i = 0; i < res.count; ++i) {
+                res.mask |= get_card_mask(&res.cards[i]);
+            }
+            if ((res.mask & users_hole_cards) == 0) {
+                return res;
+            }
+        }
+        printf("Expected 0, 3, 4 or 5 different cards that aren't your hole cards.\n");
+    }
+}
+
+// Number of players in the hand (including the user) typed by the user, or 0 at the end of the input
+uint8_t get_num_players_from_input() {
+    char line[256];
+    while (true) {
+        printf("Enter the number of players in the hand (%d-%d): ", MIN_NUM_PLAYERS, MAX_NUM_PLAYERS);
+        if (fgets(line, sizeof(line), stdin) == NULL) {
+            return 0;
+        }
+        int num_players = atoi(line);
+        if (num_players >= MIN_NUM_PLAYERS && num_players <= MAX_NUM_PLAYERS) {
+            return num_players;
+        }
+        printf("Expected a number from %d to %d.\n", MIN_NUM_PLAYERS, MAX_NUM_PLAYERS);
+    }
+}
+
+// The user's equity against opponents whose hole cards are unknown, so they're drawn from the unseen cards with the board on each trial
+void display_users_equity(HoleCards* users_hole_cards, CommunityCards* community_cards, uint8_t num_players) {
+    if (community_cards->count == 0) {
+        const PreflopEquityDatabaseEntry* entry = get_preflop_equity(users_hole_cards->cards, num_players);
+        if (entry != NULL && does_preflop_equity_meet_stopping_rule(entry, &stopping_rule_option) == true) {
+            printf("Your equity: %.2f%% (win %.2f%%, tie %.2f%%) against %d opponents (preflop database)\n", (entry->win_equity + entry->tie_equity) * 100, entry->win_equity * 100, entry->tie_equity * 100, num_players - 1);
+            return;
+        }
+    }
+    Game game = init_game(&num_players);
+    game.players.hole_cards[0] = *users_hole_cards;
+    game.community_cards = *community_cards;
+    WinningProbabilityDistribution winning_probability_distribution;
+    set_cached_winning_probability_distribution(&game, &winning_probability_distribution, &stopping_rule_option);
+    double tie_equity = winning_probability_distribution.tie_equities[0];
+    printf("Your equity: %.2f%% (win %.2f%%, tie %.2f%%) against %d opponents ", winning_probability_distribution.equities[0] * 100, (winning_probability_distribution.equities[0] - tie_equity) * 100, tie_equity * 100, num_players - 1);
+    // the opponents' errors are all the same as the user's
+    display_winning_probability_distribution_method(&winning_probability_distribution, 1);
+}
+
+// Asks for the user's hole cards, the community cards and the number of players, until the end of the input
+void tool() {
+    while (true) {
+        HoleCards users_hole_cards = get_hole_cards_from_input();
+        if (users_hole_cards.count == 0) {
+            return;
+        }
+        CommunityCards community_cards = get_community_cards_from_input(users_hole_cards.mask);
+        if (feof(stdin)) {
+            return;
+        }
+        uint8_t num_players = get_num_players_from_input();
+        if (num_players == 0) {
+            return;
+        }
+        display_users_equity(&users_hole_cards, &community_cards, num_players);
+    }
+}
+
+
+typedef struct {
+    uint16_t combination;
+    double equity;
+} RangeCombinationEquity;
+
+int compare_range_combination_equities(const void* combination_equity_0, const void* combination_equity_1) {
+    double equity_0 = ((RangeCombinationEquity*) combination_equity_0)->equity;
+    double equity_1 = ((RangeCombinationEquity*) combination_equity_1)->equity;
+    return equity_0 < equity_1 ? 1 : (equity_0 > equity_1 ? -1 : 0);
+}
+
+// Each dealt combination of the range with how often it was dealt and its equity, from the best
+void display_range_combination_equities(Range* range, uint64_t num_trials) {
+    RangeCombinationEquity combination_equities[NUM_HOLE_CARDS_COMBINATIONS];
+    uint16_t num_combinations = 0;
+    for (uint16_t combination = 0; combination < NUM_HOLE_CARDS_COMBINATIONS; ++combination) {
+        if (range->combination_num_trials[combination] > 0) {
+            combination_equities[num_combinations].combination = combination;
+            combination_equities[num_combinations].equity = range->combination_equities[combination];
+            ++num_combinations;
+        }
+    }
+    qsort(combination_equities, num_combinations, sizeof(RangeCombinationEquity), compare_range_combination_equities);
+    for (uint16_t i = 0; i < num_combinations; ++i) {
+        uint16_t combination = combination_equities[i].combination;
+        Card cards[NUM_HOLE_CARDS_PER_PLAYER];
+        get_cards_from_card_mask(hole_cards_combinations[combination], cards);
+        printf("  ");
+        print_card(&cards[1]);
+        print_card(&cards[0]);
+        printf("  weight %.2f  dealt %6.2f%%  equity %6.2f%%\n", range->weights[combination], (double) range->combination_num_trials[combination] / num_trials * 100, combination_equities[i].equity * 100);
+    }
+}
+
+// Sets up a spot where the hero (player 0) has hole cards or a range, num_opponents_ranges opponents have ranges,
+// and the other num_players - 1 - num_opponents_ranges opponents have unknown hole cards. ranges needs room for the
+// hero's range and the opponents' ones, and can be NULL if there are none. On failure, error says why.
+bool init_spot(Game* game, Range* ranges, const char* hero, const char* community_cards_text, const char** opponents_ranges, uint8_t num_opponents_ranges, uint8_t num_players, char* error, size_t error_size) {
+    if (num_players < num_opponents_ranges + 1) {
+        num_players = num_opponents_ranges + 1;
+    }
+    *game = init_game(&num_players);
+
+    if (community_cards_text != NULL) {
+        int8_t num_community_cards = parse_cards(community_cards_text, game->community_cards.cards, MAX_NUM_COMMUNITY_CARDS);
+        if (num_community_cards < 0 || num_community_cards == 1 || num_community_cards == 2) {
+            snprintf(error, error_size, "expected 0, 3, 4 or 5 different community cards: %s", community_cards_text);
+            return false;
+        }
+        game->community_cards.count = num_community_cards;
+        for (uint8_t i = 0; i < game->community_cards.count; ++i) {
+            game->community_cards.mask |= get_card_mask(&game->community_cards.cards[i]);
+        }
+    }
+    HoleCards* hero_hole_cards = &game->players.hole_cards[0];
+    if (parse_cards(hero, hero_hole_cards->cards, NUM_HOLE_CARDS_PER_PLAYER) == NUM_HOLE_CARDS_PER_PLAYER) {
+        hero_hole_cards->count = NUM_HOLE_CARDS_PER_PLAYER;
+        hero_hole_cards->mask = get_card_mask(&hero_hole_cards->cards[0]) | get_card_mask(&hero_hole_cards->cards[1]);
+        if ((hero_hole_cards->mask & game->community_cards.mask) != 0) {
+            snprintf(error, error_size, "the hero's hole cards are on the board");
+            return false;
+        }
+    }
+    else if (ranges != NULL && parse_range(hero, &ranges[0]) == true) {
+        game->players.ranges[0] = &ranges[0];
+    }
+    else {
+        snprintf(error, error_size, "not hole cards or a range: %s", hero);
+        return false;
+    }
+    for (uint8_t i = 0; i < num_opponents_ranges; ++i) {
+        if (parse_range(opponents_ranges[i], &ranges[i + 1]) == false) {
+            snprintf(error, error_size, "not a range: %s", opponents_ranges[i]);
+            return false;
+        }
+        game->players.ranges[i + 1] = &ranges[i + 1];
+    }
+    if (init_range_samplers(&game->players, game->community_cards.mask | hero_hole_cards->mask) == false) {
+        snprintf(error, error_size, "a range has no hole cards left once the known cards are taken out");
+        return false;
+    }
+    return true;
+}
+
+// Equity of the hero's hole cards or range against the opponents' ranges, and against random hole cards for the other opponents
+bool display_range_equity(const char* hero, const char* community_cards_text, const char** opponents_ranges, uint8_t num_opponents_ranges, uint8_t num_players) {
+    static Range ranges[MAX_NUM_PLAYERS];
+    Game game;
+    char error[256];
+    if (init_spot(&game, ranges, hero, community_cards_text, opponents_ranges, num_opponents_ranges, num_players, error, sizeof(error)) == false) {
+        fprintf(stderr, "%s\n", error);
+        return false;
+    }
+    num_players = game.players.count;
+
+    WinningProbabilityDistribution winning_probability_distribution;
+    SimulationTotals simulation_totals;
+    double start = get_time_in_seconds();
+    if (run_simulation(&game, &winning_probability_distribution, &stopping_rule_option, NULL, NULL, &simulation_totals) == false) {
+        fprintf(stderr, "the ranges can't be dealt together\n");
+        return false;
+    }
+    double elapsed = get_time_in_seconds() - start;
+    if (partial_results_path_option != NULL && write_partial_results(partial_results_path_option, &game, winning_probability_distribution.method, &simulation_totals) == false) {
+        return false;
+    }
+
+    double tie_equity = winning_probability_distribution.tie_equities[0];
+    printf("Hero equity: %.2f%% (win %.2f%%, tie %.2f%%) against %d opponents, %.0f trials/sec ", winning_probability_distribution.equities[0] * 100, (winning_probability_distribution.equities[0] - tie_equity) * 100, tie_equity * 100, num_players - 1, winning_probability_distribution.num_trials / elapsed);
+    display_winning_probability_distribution_method(&winning_probability_distribution, 1);
+    display_hand_rank_distribution(&simulation_totals);
+    for (uint8_t i = 0; i <= num_opponents_ranges; ++i) {
+        if (game.players.ranges[i] != NULL) {
+            printf("%s range, %d possible combinations:\n", i == 0 ? "Hero's" : "Opponent's", ranges[i].num_live_combinations);
+            display_range_combination_equities(&ranges[i], winning_probability_distribution.num_trials);
+        }
+    }
+    return true;
+}
+
+int compare_next_cards_equities(const void* next_card_equities_0, const void* next_card_equities_1) {
+    double equity_0 = ((NextCardEquities*) next_card_equities_0)->winning_probability_distribution.equities[0];
+    double equity_1 = ((NextCardEquities*) next_card_equities_1)->winning_probability_distribution.equities[0];
+    return equity_0 < equity_1 ? 1 : (equity_0 > equity_1 ? -1 : 0);
+}
+
+// Every player's equity once each card that can come next is dealt, from the hero's best card, and how many of the
+// cards improve each player's current equity, lower it, or make them the favorite (alone with the highest equity)
+bool display_outs(const char* hero, const char* community_cards_text, const char** opponents_ranges, uint8_t num_opponents_ranges, uint8_t num_players) {
+    static Range ranges[MAX_NUM_PLAYERS];
+    static NextCardEquities next_cards_equities[STANDARD_DECK_SIZE];
+    Game game;
+    char error[256];
+    if (init_spot(&game, ranges, hero, community_cards_text, opponents_ranges, num_opponents_ranges, num_players, error, sizeof(error)) == false) {
+        fprintf(stderr, "%s\n", error);
+        return false;
+    }
+    if (game.community_cards.count != 3 && game.community_cards.count != 4) {
+        fprintf(stderr, "expected the flop or the turn on the board\n");
+        return false;
+    }
+    if (num_shards > 1) {
+        fprintf(stderr, "--shard only applies to simulations whose partial results are merged\n");
+        return false;
+    }
+    num_players = game.players.count;
+
+    WinningProbabilityDistribution winning_probability_distribution;
+    if (run_simulation(&game, &winning_probability_distribution, &stopping_rule_option, NULL, NULL, NULL) == false) {
+        fprintf(stderr, "the ranges can't be dealt together\n");
+        return false;
+    }
+    double start = get_time_in_seconds();
+    uint8_t num_next_cards = set_next_cards_equities(&game, &stopping_rule_option, next_cards_equities);
+    double elapsed = get_time_in_seconds() - start;
+    uint8_t num_possible_next_cards = 0;
+    uint64_t num_trials = 0;
+    for (uint8_t i = 0; i < num_next_cards; ++i) {
+        if (next_cards_equities[i].is_possible == true) {
+            num_trials += next_cards_equities[i].winning_probability_distribution.num_trials;
+            next_cards_equities[num_possible_next_cards++] = next_cards_equities[i];
+        }
+    }
+    qsort(next_cards_equities, num_possible_next_cards, sizeof(NextCardEquities), compare_next_cards_equities);
+
+    printf("Card ");
+    printf("     Hero");
+    for (uint8_t i = 1; i < num_players; ++i) {
+        printf("   Opp %2d", i);
+    }
+    printf("   Change\n");
+    printf("Now  ");
+    for (uint8_t i = 0; i < num_players; ++i) {
+        printf(" %7.2f%%", winning_probability_distribution.equities[i] * 100);
+    }
+    printf("\n");
+    uint8_t num_improving_cards[MAX_NUM_PLAYERS] = {0};
+    uint8_t num_worsening_cards[MAX_NUM_PLAYERS] = {0};
+    uint8_t num_favorite_cards[MAX_NUM_PLAYERS] = {0};
+    for (uint8_t i = 0; i < num_possible_next_cards; ++i) {
+        double* equities = next_cards_equities[i].winning_probability_distribution.equities;
+        uint8_t favorite = 0;
+        bool is_favorite_alone = true;
+        for (uint8_t j = 0; j < num_players; ++j) {
+            if (equities[j] > winning_probability_distribution.equities[j]) {
+                ++num_improving_cards[j];
+            }
+            else if (equities[j] < winning_probability_distribution.equities[j]) {
+                ++num_worsening_cards[j];
+            }
+            if (j > 0 && equities[j] > equities[favorite]) {
+                favorite = j;
+                is_favorite_alone = true;
+            }
+            else if (j > 0 && equities[j] == equities[favorite]) {
+                is_favorite_alone = false;
+            }
+        }
+        if (is_favorite_alone == true) {
+            ++num_favorite_cards[favorite];
+        }
+
+        Card card;
+        get_cards_from_card_mask((CardMask) 1 << next_cards_equities[i].card_index, &card);
+        print_card(&card);
+        printf("%*s", card.rank == TEN ? 2 : 3, "");
+        for (uint8_t j = 0; j < num_players; ++j) {
+            printf(" %7.2f%%", equities[j] * 100);
+        }
+        printf("  %+6.2f%%\n", (equities[0] - winning_probability_distribution.equities[0]) * 100);
+    }
+    for (uint8_t i = 0; i < num_players; ++i) {
+        if (i == 0) {
+            printf("Hero:");
+        }
+        else {
+            printf("Opp %d:", i);
+        }
+        printf(" %d outs to be the favorite, %d cards improve the equity, %d lower it\n", num_favorite_cards[i], num_improving_cards[i], num_worsening_cards[i]);
+    }
+    if (num_possible_next_cards < num_next_cards) {
+        printf("%d cards leave a range without hole cards\n", num_next_cards - num_possible_next_cards);
+    }
+    printf("%d next cards in %.2f seconds (%.0f trials/sec) ", num_possible_next_cards, elapsed, num_trials / elapsed);
+    if (num_possible_next_cards > 0 && next_cards_equities[0].winning_probability_distribution.method == EXACT_ENUMERATION) {
+        printf("(exact: %llu board completions)\n", (unsigned long long) num_trials);
+    }
+    else {
+        printf("(Monte Carlo: %llu trials)\n", (unsigned long long) num_trials);
+    }
+    return true;
+}
+
+// The hero's equity against 1 to 21 opponents, from a single simulation of the full table: the opponents with
+// ranges sit first, and the tables of 2 to 21 players are made of the first ones
+bool display_equity_curve(const char* hero, const char* community_cards_text, const char** opponents_ranges, uint8_t num_opponents_ranges) {
+    static Range ranges[MAX_NUM_PLAYERS];
+    Game game;
+    char error[256];
+    if (init_spot(&game, ranges, hero, community_cards_text, opponents_ranges, num_opponents_ranges, MAX_NUM_PLAYERS, error, sizeof(error)) == false) {
+        fprintf(stderr, "%s\n", error);
+        return false;
+    }
+
+    WinningProbabilityDistribution winning_probability_distribution;
+    EquityCurve equity_curve;
+    double start = get_time_in_seconds();
+    if (run_simulation(&game, &winning_probability_distribution, &stopping_rule_option, &equity_curve, NULL, NULL) == false) {
+        fprintf(stderr, "the ranges can't be dealt together\n");
+        return false;
+    }
+    double elapsed = get_time_in_seconds() - start;
+
+    printf("Players   Equity      Win      Tie   Std error\n");
+    for (uint8_t num_players = MIN_NUM_PLAYERS; num_players <= MAX_NUM_PLAYERS; ++num_players) {
+        double tie_equity = equity_curve.tie_equities[num_players];
+        printf("%7d  %6.2f%%  %6.2f%%  %6.2f%%  %9.3f%%\n", num_players, equity_curve.equities[num_players] * 100, (equity_curve.equities[num_players] - tie_equity) * 100, tie_equity * 100, equity_curve.standard_errors[num_players] * 100);
+    }
+    printf("%llu trials of the %d-player table in %.2f seconds (%.0f trials/sec)\n", (unsigned long long) equity_curve.num_trials, MAX_NUM_PLAYERS, elapsed, equity_curve.num_trials / elapsed);
+    return true;
+}
+
+// The equities of several hole cards for the hero on the same spot, from one simulation where they all play the same
+// trials: the first hole cards are the game's hero's, and the others' equities are compared with theirs
+bool display_hero_comparison(const char* hands_text, const char* community_cards_text, uint8_t num_players) {
+    char hands[MAX_NUM_ALTERNATIVE_HEROES + 1][16];
+    uint8_t num_hands = 0;
+    const char* text = hands_text;
+    while (*text != '\0') {
+        const char* end = strchr(text, ',');
+        size_t length = end != NULL ? (size_t) (end - text) : strlen(text);
+        if (num_hands == MAX_NUM_ALTERNATIVE_HEROES + 1 || length >= sizeof(hands[0])) {
+            fprintf(stderr, "expected at most %d comma-separated hole cards: %s\n", MAX_NUM_ALTERNATIVE_HEROES + 1, hands_text);
+            return false;
+        }
+        memcpy(hands[num_hands], text, length);
+        hands[num_hands++][length] = '\0';
+        text += length;
+        if (*text == ',') {
+            ++text;
+        }
+    }
+    if (num_hands < 2) {
+        fprintf(stderr, "expected at least 2 comma-separated hole cards: %s\n", hands_text);
+        return false;
+    }
+
+    Game game;
+    char error[256];
+    if (init_spot(&game, NULL, hands[0], community_cards_text, NULL, 0, num_players, error, sizeof(error)) == false) {
+        fprintf(stderr, "%s\n", error);
+        return false;
+    }
+    HeroComparison hero_comparison;
+    hero_comparison.count = 0;
+    for (uint8_t i = 1; i < num_hands; ++i) {
+        Card cards[NUM_HOLE_CARDS_PER_PLAYER];
+        if (parse_cards(hands[i], cards, NUM_HOLE_CARDS_PER_PLAYER) != NUM_HOLE_CARDS_PER_PLAYER) {
+            fprintf(stderr, "not hole cards: %s\n", hands[i]);
+            return false;
+        }
+        CardMask hole_cards = get_card_mask(&cards[0]) | get_card_mask(&cards[1]);
+        if ((hole_cards & game.community_cards.mask) != 0) {
+            fprintf(stderr, "%s are on the board\n", hands[i]);
+            return false;
+        }
+        hero_comparison.hole_cards[hero_comparison.count++] = hole_cards;
+    }
+
+    WinningProbabilityDistribution winning_probability_distribution;
+    double start = get_time_in_seconds();
+    run_simulation(&game, &winning_probability_distribution, &stopping_rule_option, NULL, &hero_comparison, NULL);
+    double elapsed = get_time_in_seconds() - start;
+
+    printf("Hand     Equity  Std error  Difference  Paired std error  Separate std error\n");
+    printf("%-6s  %6.2f%%  %8.3f%%\n", hands[0], winning_probability_distribution.equities[0] * 100, winning_probability_distribution.standard_errors[0] * 100);
+    for (uint8_t i = 0; i < hero_comparison.count; ++i) {
+        printf("%-6s  %6.2f%%  %8.3f%%  %+9.2f%%  %15.3f%%  %17.3f%%\n", hands[i + 1], hero_comparison.equities[i] * 100, hero_comparison.standard_errors[i] * 100, (hero_comparison.equities[i] - winning_probability_distribution.equities[0]) * 100, hero_comparison.difference_standard_errors[i] * 100, hero_comparison.independent_difference_standard_errors[i] * 100);
+    }
+    printf("%llu trials against %d opponents in %.2f seconds\n", (unsigned long long) winning_probability_distribution.num_trials, game.players.count - 1, elapsed);
+    return true;
+}
+
+// Adds up the partial results of any set of shards of one simulation, each at most once, and shows every player's
+// equity. The totals are integers, so all the shards give exactly the results of the unsharded simulation.
+bool merge_partial_results(const char* paths_text) {
+    PartialResultsHeader first_header;
+    SimulationTotals totals;
+    bool* merged_shards = NULL;
+    uint32_t num_merged_shards = 0;
+    bool res = true;
+    const char* text = paths_text;
+    while (*text != '\0' && res == true) {
+        const char* end = strchr(text, ',');
+        size_t length = end != NULL ? (size_t) (end - text) : strlen(text);
+        char path[4096];
+        snprintf(path, sizeof(path), "%.*s", (int) length, text);
+        text += length;
+        if (*text == ',') {
+            ++text;
+        }
+
+        PartialResultsHeader header;
+        SimulationTotals shard_totals;
+        if (read_partial_results(path, &header, &shard_totals) == false) {
+            res = false;
+        }
+        else if (merged_shards == NULL) {
+            first_header = header;
+            totals = shard_totals;
+            merged_shards = calloc(header.num_shards, sizeof(bool));
+            merged_shards[header.shard_index] = true;
+            ++num_merged_shards;
+        }
+        else if (header.simulation_hash != first_header.simulation_hash || header.num_shards != first_header.num_shards) {
+            fprintf(stderr, "%s: a shard of another simulation\n", path);
+            res = false;
+        }
+        else if (merged_shards[header.shard_index] == true) {
+            fprintf(stderr, "%s: shard %u is already merged\n", path, header.shard_index);
+            res = false;
+        }
+        else {
+            add_simulation_totals(&totals, &shard_totals);
+            merged_shards[header.shard_index] = true;
+            ++num_merged_shards;
+        }
+    }
+    free(merged_shards);
+    if (res == false) {
+        return false;
+    }
+    if (num_merged_shards == 0) {
+        fprintf(stderr, "expected comma-separated partial results files: %s\n", paths_text);
+        return false;
+    }
+
+    WinningProbabilityDistribution winning_probability_distribution;
+    set_winning_probability_distribution_from_totals(&winning_probability_distribution, &totals);
+    winning_probability_distribution.method = first_header.method;
+    winning_probability_distribution.is_cached = false;
+    printf("Merged %u of %u shards: ", num_merged_shards, first_header.num_shards);
+    display_winning_probability_distribution_method(&winning_probability_distribution, totals.num_players);
+    for (uint8_t i = 0; i < totals.num_players; ++i) {
+        double tie_equity = winning_probability_distribution.tie_equities[i];
+        printf("Player %d: equity %.4f%% (win %.4f%%, tie %.4f%%), standard error %.4f%%\n", i + 1, winning_probability_distribution.equities[i] * 100, (winning_probability_distribution.equities[i] - tie_equity) * 100, tie_equity * 100, winning_probability_distribution.standard_errors[i] * 100);
+    }
+    display_hand_rank_distribution(&totals);
+    return true;
+}
+
+// Trials/sec of a full set_winning_probability_distribution call, from 1 thread up to --threads
+void run_scaling_benchmark(uint8_t num_players) {
+    Game game = init_game(&num_players);
+    game.deck = get_shuffled_deck(&original_unshuffled_standard_deck, &main_random_number_generator);
+    deal_hole_cards(&game.players, &game.deck);
+    WinningProbabilityDistribution winning_probability_distribution;
+
+    uint16_t max_num_threads = num_threads;
+    double single_thread_trials_per_second = 0;
+    printf("threads  trials/sec    speedup\n");
+    for (num_threads = 1; num_threads <= max_num_threads; ++num_threads) {
+        double start = get_time_in_seconds();
+        set_winning_probability_distribution(&game, &winning_probability_distribution, &stopping_rule_option);
+        double trials_per_second = winning_probability_distribution.num_trials / (get_time_in_seconds() - start);
+        if (num_threads == 1) {
+            single_thread_trials_per_second = trials_per_second;
+        }
+        printf("%7u %11.0f %9.2fx\n", num_threads, trials_per_second, trials_per_second / single_thread_trials_per_second);
+    }
+    num_threads = max_num_threads;
+}
+
+// Trials/sec of preflop tables of unknown hands, with the bytes of trial state each trial writes: the drawn card
+// indices swapped to the front of the deck, the hole cards dealt, and a strength and an equity for every player
+void run_trial_state_benchmark() {
+    uint8_t table_sizes[] = { 2, 6, 9, MAX_NUM_PLAYERS };
+    WinningProbabilityDistribution winning_probability_distribution;
+    printf("trial scratch: %zu bytes, worker: %zu bytes\n", sizeof(TrialScratch), sizeof(SimulationWorker));
+    printf("players  bytes/trial   trials/sec\n");
+    for (uint8_t i = 0; i < sizeof(table_sizes) / sizeof(table_sizes[0]); ++i) {
+        uint8_t num_players = table_sizes[i];
+        Game game = init_game(&num_players);
+        uint8_t num_drawn_cards = (num_players - 1) * NUM_HOLE_CARDS_PER_PLAYER + MAX_NUM_COMMUNITY_CARDS;
+        size_t num_bytes_per_trial = num_drawn_cards * 2 * sizeof(uint8_t) + (num_players - 1) * sizeof(CardMask) + num_players * (sizeof(uint32_t) + sizeof(double));
+        game.deck = get_shuffled_deck(&original_unshuffled_standard_deck, &main_random_number_generator);
+        deal_card(&game.deck, game.players.hole_cards[0].cards, &game.players.hole_cards[0].count, &game.players.hole_cards[0].mask);
+        deal_card(&game.deck, game.players.hole_cards[0].cards, &game.players.hole_cards[0].count, &game.players.hole_cards[0].mask);
+
+        double start = get_time_in_seconds();
+        set_winning_probability_distribution(&game, &winning_probability_distribution, &stopping_rule_option);
+        double trials_per_second = winning_probability_distribution.num_trials / (get_time_in_seconds() - start);
+        printf("%7u %12zu %12.0f\n", num_players, num_bytes_per_trial, trials_per_second);
+    }
+}
+
+#define NUM_VARIANCE_REDUCTION_BENCHMARK_RUNS 1000
+#define NUM_VARIANCE_REDUCTION_BENCHMARK_TRIALS 4000
+
+typedef struct {
+    const char* hero;
+    const char* community_cards;
+    // the opponent's hole cards, or NULL for opponents with unknown ones
+    const char* opponent;
+    uint8_t num_players;
+} VarianceReductionBenchmarkSpot;
+
+// Sets up a spot of the benchmark, whose cards are all valid
+Game init_variance_reduction_benchmark_game(VarianceReductionBenchmarkSpot* spot) {
+    Game res;
+    char error[256];
+    init_spot(&res, NULL, spot->hero, spot->community_cards, NULL, 0, spot->num_players, error, sizeof(error));
+    if (spot->opponent != NULL) {
+        HoleCards* hole_cards = &res.players.hole_cards[1];
+        hole_cards->count = parse_cards(spot->opponent, hole_cards->cards, NUM_HOLE_CARDS_PER_PLAYER);
+        hole_cards->mask = get_card_mask(&hole_cards->cards[0]) | get_card_mask(&hole_cards->cards[1]);
+    }
+    return res;
+}
+
+// The observed variance of the hero's equity over repeated Monte Carlo runs of each sampling method, as a ratio to plain
+// sampling's (how many times fewer trials reach the same error), with how well the reported standard errors match it.
+// Then, for a comparison of hole cards, the variance of the differences from paired trials against separate simulations.
+bool run_variance_reduction_benchmark() {
+    VarianceReductionBenchmarkSpot spots[] = {
+        { "AhKh", NULL, "QsQd", 2 },
+        { "AhKh", NULL, NULL, 6 },
+        { "AhKh", "Th7h2c", "QsQd", 2 },
+        { "AhKh", "Th7h2c", NULL, 3 },
+        { "AhKh", "Th7h2c9s", "QsQd", 2 },
+    };
+    const char* sampling_method_names[] = { "plain", "stratified", "antithetic" };
+    uint8_t saved_simulation_method = simulation_method;
+    uint8_t saved_sampling_method = requested_sampling_method;
+    simulation_method = MONTE_CARLO;
+    StoppingRule stopping_rule = init_stopping_rule();
+    stopping_rule.max_num_trials = NUM_VARIANCE_REDUCTION_BENCHMARK_TRIALS;
+    WinningProbabilityDistribution winning_probability_distribution;
+
+    printf("spot                        players  sampling    variance ratio  reported/observed   trials/sec\n");
+    for (uint8_t i = 0; i < sizeof(spots) / sizeof(spots[0]); ++i) {
+        VarianceReductionBenchmarkSpot* spot = &spots[i];
+        Game game = init_variance_reduction_benchmark_game(spot);
+        char spot_name[64];
+        snprintf(spot_name, sizeof(spot_name), "%s vs %s%s%s", spot->hero, spot->opponent != NULL ? spot->opponent : "random", spot->community_cards != NULL ? " on " : "", spot->community_cards != NULL ? spot->community_cards : "");
+        double plain_variance = 0;
+        for (uint8_t method = PLAIN_SAMPLING; method <= ANTITHETIC_SAMPLING; ++method) {
+            requested_sampling_method = method;
+            double equities = 0;
+            double squared_equities = 0;
+            double squared_standard_errors = 0;
+            uint64_t num_trials = 0;
+            double start = get_time_in_seconds();
+            for (uint16_t run = 0; run < NUM_VARIANCE_REDUCTION_BENCHMARK_RUNS; ++run) {
+                set_winning_probability_distribution(&game, &winning_probability_distribution, &stopping_rule);
+                equities += winning_probability_distribution.equities[0];
+                squared_equities += winning_probability_distribution.equities[0] * winning_probability_distribution.equities[0];
+                squared_standard_errors += winning_probability_distribution.standard_errors[0] * winning_probability_distribution.standard_errors[0];
+                num_trials += winning_probability_distribution.num_trials;
+            }
+            double elapsed = get_time_in_seconds() - start;
+            double mean = equities / NUM_VARIANCE_REDUCTION_BENCHMARK_RUNS;
+            double variance = (squared_equities - NUM_VARIANCE_REDUCTION_BENCHMARK_RUNS * mean * mean) / (NUM_VARIANCE_REDUCTION_BENCHMARK_RUNS - 1);
+            if (method == PLAIN_SAMPLING) {
+                plain_variance = variance;
+            }
+            // stratifying the last community card to deal enumerates the board completions, up to rounding errors
+            if (variance < plain_variance * 1e-9) {
+                printf("%-28s %7d  %-10s %15s %18s %12.0f\n", spot_name, spot->num_players, sampling_method_names[method], "exact", "-", num_trials / elapsed);
+                continue;
+            }
+            printf("%-28s %7d  %-10s %15.2f %18.2f %12.0f\n", spot_name, spot->num_players, sampling_method_names[method], plain_variance / variance, squared_standard_errors / NUM_VARIANCE_REDUCTION_BENCHMARK_RUNS / variance, num_trials / elapsed);
+        }
+    }
+    requested_sampling_method = PLAIN_SAMPLING;
+
+    // common random numbers: the alternative heroes play the game's hero's trials
+    VarianceReductionBenchmarkSpot spot = { "AhKh", NULL, NULL, 6 };
+    const char* alternative_heroes[] = { "AhKd", "AsKs", "QhQd", "7c2d" };
+    Game game = init_variance_reduction_benchmark_game(&spot);
+    HeroComparison hero_comparison;
+    hero_comparison.count = sizeof(alternative_heroes) / sizeof(alternative_heroes[0]);
+    for (uint8_t i = 0; i < hero_comparison.count; ++i) {
+        Card cards[NUM_HOLE_CARDS_PER_PLAYER];
+        parse_cards(alternative_heroes[i], cards, NUM_HOLE_CARDS_PER_PLAYER);
+        hero_comparison.hole_cards[i] = get_card_mask(&cards[0]) | get_card_mask(&cards[1]);
+    }
+    double differences[MAX_NUM_ALTERNATIVE_HEROES] = { 0 };
+    double squared_differences[MAX_NUM_ALTERNATIVE_HEROES] = { 0 };
+    double squared_paired_standard_errors[MAX_NUM_ALTERNATIVE_HEROES] = { 0 };
+    double squared_independent_standard_errors[MAX_NUM_ALTERNATIVE_HEROES] = { 0 };
+    for (uint16_t run = 0; run < NUM_VARIANCE_REDUCTION_BENCHMARK_RUNS; ++run) {
+        run_simulation(&game, &winning_probability_distribution, &stopping_rule, NULL, &hero_comparison, NULL);
+        for (uint8_t i = 0; i < hero_comparison.count; ++i) {
+            double difference = hero_comparison.equities[i] - winning_probability_distribution.equities[0];
+            differences[i] += difference;
+            squared_differences[i] += difference * difference;
+            squared_paired_standard_errors[i] += hero_comparison.difference_standard_errors[i] * hero_comparison.difference_standard_errors[i];
+            squared_independent_standard_errors[i] += hero_comparison.independent_difference_standard_errors[i] * hero_comparison.independent_difference_standard_errors[i];
+        }
+    }
+    printf("\ncomparison with %s vs random, %d players  variance ratio  reported/observed\n", spot.hero, spot.num_players);
+    for (uint8_t i = 0; i < hero_comparison.count; ++i) {
+        double mean = differences[i] / NUM_VARIANCE_REDUCTION_BENCHMARK_RUNS;
+        double variance = (squared_differences[i] - NUM_VARIANCE_REDUCTION_BENCHMARK_RUNS * mean * mean) / (NUM_VARIANCE_REDUCTION_BENCHMARK_RUNS - 1);
+        printf("%-40s %15.2f %18.2f\n", alternative_heroes[i], squared_independent_standard_errors[i] / NUM_VARIANCE_REDUCTION_BENCHMARK_RUNS / variance, squared_paired_standard_errors[i] / NUM_VARIANCE_REDUCTION_BENCHMARK_RUNS / variance);
+    }
+    simulation_method = saved_simulation_method;
+    requested_sampling_method = saved_sampling_method;
+    return true;
+}
+
+#define NUM_DEALING_BENCHMARK_TRIALS 200000
+
+// Cards dealt/sec of a preflop heads-up runout: the old full shuffle against the partial Fisher-Yates draw, for each generator
+void run_dealing_benchmark() {
+    uint8_t num_players = MIN_NUM_PLAYERS;
+    Game game = init_game(&num_players);
+    game.deck = get_shuffled_deck(&original_unshuffled_standard_deck, &main_random_number_generator);
+    deal_hole_cards(&game.players, &game.deck);
+    Deck unseen_cards = get_deck_from_card_mask(get_unseen_cards_from_perspective_of_tv_watcher(&game.players, &game.community_cards));
+
+    const char* algorithm_names[] = { "xoshiro256**", "pcg32", "rand_r" };
+    CardMask checksum = 0;
+    printf("generator     dealing                cards/sec\n");
+    for (uint8_t algorithm = XOSHIRO256_STAR_STAR; algorithm <= RAND_R; ++algorithm) {
+        RandomNumberGenerator random_number_generator = init_random_number_generator(algorithm, time(NULL), 0);
+
+        double start = get_time_in_seconds();
+        for (uint32_t i = 0; i < NUM_DEALING_BENCHMARK_TRIALS; ++i) {
+            Deck possible_deck = get_shuffled_deck(&unseen_cards, &random_number_generator);
+            BurnedCards possible_burned_cards = init_burned_cards();
+            CommunityCards community_cards = init_community_cards();
+            deal_the_flop(&community_cards, &possible_deck, &possible_burned_cards);
+            deal_the_turn(&community_cards, &possible_deck, &possible_burned_cards);
+            deal_the_river(&community_cards, &possible_deck, &possible_burned_cards);
+            checksum ^= community_cards.mask;
+        }
+        double elapsed = get_time_in_seconds() - start;
+        printf("%-13s %-18s %13.0f\n", algorithm_names[algorithm], "full shuffle", NUM_DEALING_BENCHMARK_TRIALS * MAX_NUM_COMMUNITY_CARDS / elapsed);
+
+        start = get_time_in_seconds();
+        for (uint32_t i = 0; i < NUM_DEALING_BENCHMARK_TRIALS; ++i) {
+            checksum ^= draw_random_cards(&unseen_cards, MAX_NUM_COMMUNITY_CARDS, &random_number_generator);
+        }
+        elapsed = get_time_in_seconds() - start;
+        printf("%-13s %-18s %13.0f\n", algorithm_names[algorithm], "partial shuffle", NUM_DEALING_BENCHMARK_TRIALS * MAX_NUM_COMMUNITY_CARDS / elapsed);
+    }
+    printf("(checksum %llx)\n", (unsigned long long) checksum);
+}
+
+#define NUM_CACHE_BENCHMARK_QUERIES 100000
+
+// Queries suit-permuted copies of one spot: the first one misses, every other one should hit
+void run_cache_benchmark(uint8_t num_players) {
+    Game game = init_game(&num_players);
+    game.deck = get_shuffled_deck(&original_unshuffled_standard_deck, &main_random_number_generator);
+    deal_hole_cards(&game.players, &game.deck);
+    deal_the_flop(&game.community_cards, &game.deck, &game.burned_cards);
+    WinningProbabilityDistribution winning_probability_distribution;
+
+    double start = get_time_in_seconds();
+    set_cached_winning_probability_distribution(&game, &winning_probability_distribution, &stopping_rule_option);
+    printf("miss: %.3f ms\n", (get_time_in_seconds() - start) * 1e3);
+
+    Game permuted_games[NUM_SUIT_PERMUTATIONS];
+    for (uint8_t permutation = 0; permutation < NUM_SUIT_PERMUTATIONS; ++permutation) {
+        permuted_games[permutation] = game;
+        Game* permuted_game = &permuted_games[permutation];
+        permuted_game->community_cards.mask = permute_suits(game.community_cards.mask, suit_permutations[permutation]);
+        for (uint8_t i = 0; i < num_players; ++i) {
+            permuted_game->players.hole_cards[i].mask = permute_suits(game.players.hole_cards[i].mask, suit_permutations[permutation]);
+        }
+    }
+    start = get_time_in_seconds();
+    for (uint32_t i = 0; i < NUM_CACHE_BENCHMARK_QUERIES; ++i) {
+        set_cached_winning_probability_distribution(&permuted_games[i % NUM_SUIT_PERMUTATIONS], &winning_probability_distribution, &stopping_rule_option);
+    }
+    printf("hit: %.3f us\n", (get_time_in_seconds() - start) * 1e6 / NUM_CACHE_BENCHMARK_QUERIES);
+    printf("hits: %llu, misses: %llu\n", (unsigned long long) result_cache.num_hits, (unsigned long long) result_cache.num_misses);
+}
+
+#define NUM_BATCH_EVALUATOR_BENCHMARK_HANDS (1 << 20)
+#define NUM_BATCH_EVALUATOR_BENCHMARK_ROUNDS 10
+#define NUM_BRUTE_FORCE_CHECKED_HANDS 100000
+
+// Checks every supported kernel for bit-exact agreement with the scalar evaluators, then reports hands/sec for each
+bool run_batch_evaluator_benchmark() {
+    CardMask* hole_cards = malloc(NUM_BATCH_EVALUATOR_BENCHMARK_HANDS * sizeof(CardMask));
+    CardMask* community_cards = malloc(NUM_BATCH_EVALUATOR_BENCHMARK_HANDS * sizeof(CardMask));
+    uint32_t* expected_strengths = malloc(NUM_BATCH_EVALUATOR_BENCHMARK_HANDS * sizeof(uint32_t));
+    uint32_t* strengths = malloc(NUM_BATCH_EVALUATOR_BENCHMARK_HANDS * sizeof(uint32_t));
+    Deck deck = get_unshuffled_standard_deck();
+    uint32_t i;
+    for (i = 0; i < NUM_BATCH_EVALUATOR_BENCHMARK_HANDS; ++i) {
+        // the drawn cards end up at the front of the deck, the first two are the hole cards
+        CardMask cards = draw_random_cards(&deck, NUM_HOLE_CARDS_PER_PLAYER + MAX_NUM_COMMUNITY_CARDS, &main_random_number_generator);
+        hole_cards[i] = get_card_mask(&deck.cards[0]) | get_card_mask(&deck.cards[1]);
+        community_cards[i] = cards & ~hole_cards[i];
+        expected_strengths[i] = get_player_strongest_hand_from_lookup_tables(hole_cards[i], community_cards[i]);
+    }
+    uint32_t num_brute_force_mismatches = 0;
+    for (i = 0; i < NUM_BRUTE_FORCE_CHECKED_HANDS; ++i) {
+        if (get_player_strongest_hand_by_brute_force(hole_cards[i], community_cards[i]) != expected_strengths[i]) {
+            ++num_brute_force_mismatches;
+        }
+    }
+    printf("lookup tables against hand_strength: %u mismatches in %d hands\n", num_brute_force_mismatches, NUM_BRUTE_FORCE_CHECKED_HANDS);
+
+    bool res = num_brute_force_mismatches == 0;
+    uint8_t selected_kernel = batch_hand_evaluation_kernel;
+    for (uint8_t kernel = SCALAR_KERNEL; kernel <= AVX512_KERNEL; ++kernel) {
+        if (is_batch_hand_evaluation_kernel_supported(kernel) == false) {
+            printf("%-7s not supported by this CPU\n", batch_hand_evaluation_kernel_names[kernel]);
+            continue;
+        }
+        select_batch_hand_evaluation_kernel(kernel);
+        evaluate_hands(hole_cards, community_cards, strengths, NUM_BATCH_EVALUATOR_BENCHMARK_HANDS);
+        uint32_t num_mismatches = 0;
+        for (i = 0; i < NUM_BATCH_EVALUATOR_BENCHMARK_HANDS; ++i) {
+            if (strengths[i] != expected_strengths[i]) {
+                ++num_mismatches;
+            }
+        }
+        double start = get_time_in_seconds();
+        for (uint8_t round = 0; round < NUM_BATCH_EVALUATOR_BENCHMARK_ROUNDS; ++round) {
+            evaluate_hands(hole_cards, community_cards, strengths, NUM_BATCH_EVALUATOR_BENCHMARK_HANDS);
+        }
+        double elapsed = get_time_in_seconds() - start;
+        printf("%-7s %12.0f hands/sec, %u mismatches in %d hands\n", batch_hand_evaluation_kernel_names[kernel], (double) NUM_BATCH_EVALUATOR_BENCHMARK_HANDS * NUM_BATCH_EVALUATOR_BENCHMARK_ROUNDS / elapsed, num_mismatches, NUM_BATCH_EVALUATOR_BENCHMARK_HANDS);
+        if (num_mismatches > 0) {
+            res = false;
+        }
+    }
+    select_batch_hand_evaluation_kernel(selected_kernel);
+
+    free(hole_cards);
+    free(community_cards);
+    free(expected_strengths);
+    free(strengths);
+    return res;
+}
+
+// #############################################
+// Evaluator validation
+// #############################################
+
+// Evaluates every 5-card and every 7-card hand, split by highest card across --threads threads. The hand rank counts
+// must match the known totals, and the evaluators must agree on every hand: hand_strength, the lookup tables, the
+// shared-board evaluator and the batch kernels on all the 5-card hands; all but hand_strength on the 7-card hands, with
+// the brute force evaluator (which calls hand_strength 21 times a hand) on every BRUTE_FORCE_VALIDATION_STRIDE-th one.
+
+#define BRUTE_FORCE_VALIDATION_STRIDE 1000
+#define VALIDATION_BATCH_SIZE 1024
+
+const uint64_t num_five_card_hands_by_hand_rank[NUM_HAND_RANKS] = { 1302540, 1098240, 123552, 54912, 10200, 5108, 3744, 624, 40 };
+const uint64_t num_seven_card_hands_by_hand_rank[NUM_HAND_RANKS] = { 23294460, 58627800, 31433400, 6461620, 6180020, 4047644, 3473184, 224848, 41584 };
+
+typedef struct {
+    uint8_t num_cards;
+    pthread_mutex_t* lock;
+    // the next highest card index to enumerate the hands of
+    uint8_t* next_highest_card_index;
+    uint64_t num_hands_by_hand_rank[NUM_HAND_RANKS];
+    uint64_t num_hands;
+    uint64_t num_mismatches;
+    uint64_t num_brute_force_checks;
+    // time spent in each evaluator
+    double hand_strength_seconds;
+    double lookup_table_seconds;
+    double batch_kernel_seconds;
+    double brute_force_seconds;
+    CardMask hands[VALIDATION_BATCH_SIZE];
+    CardMask no_community_cards[VALIDATION_BATCH_SIZE];
+    uint32_t strengths[VALIDATION_BATCH_SIZE];
+    uint32_t batch_strengths[VALIDATION_BATCH_SIZE];
+    uint32_t num_hands_in_batch;
+} ValidationWorker;
+
+void report_validation_mismatch(const char* evaluator, CardMask hand, uint32_t expected_strength, uint32_t strength) {
+    Card cards[MAX_NUM_COMMUNITY_CARDS + NUM_HOLE_CARDS_PER_PLAYER];
+    uint8_t num_cards = get_cards_from_card_mask(hand, cards);
+    fprintf(stderr, "Mismatch (%s): ", evaluator);
+    for (uint8_t i = 0; i < num_cards; ++i) {
+        fprintf(stderr, "%s%c ", card_rank_to_human_readable[cards[i].rank], "cdhs"[cards[i].suit]);
+    }
+    fprintf(stderr, "scored %u instead of %u\n", strength, expected_strength);
+}
+
+// Scores the batch with every evaluator, counts the hand ranks and checks the evaluators against each other
+void validate_batch(ValidationWorker* worker) {
+    uint32_t i;
+    double start = get_time_in_seconds();
+    for (i = 0; i < worker->num_hands_in_batch; ++i) {
+        worker->strengths[i] = evaluate_card_mask(worker->hands[i]);
+    }
+    double lookup_table_end = get_time_in_seconds();
+    evaluate_hands(worker->hands, worker->no_community_cards, worker->batch_strengths, worker->num_hands_in_batch);
+    double batch_kernel_end = get_time_in_seconds();
+    worker->lookup_table_seconds += lookup_table_end - start;
+    worker->batch_kernel_seconds += batch_kernel_end - lookup_table_end;
+
+    for (i = 0; i < worker->num_hands_in_batch; ++i) {
+        // the two lowest cards as hole cards, the others as the board
+        CardMask hole_cards = worker->hands[i] & -worker->hands[i];
+        hole_cards |= (worker->hands[i] & ~hole_cards) & -(worker->hands[i] & ~hole_cards);
+        BoardState board_state = get_board_state(worker->hands[i] & ~hole_cards);
+        uint32_t shared_board_strength = evaluate_hole_cards_on_board(&board_state, hole_cards);
+        if (shared_board_strength != worker->strengths[i] && worker->num_mismatches++ == 0) {
+            report_validation_mismatch("shared board", worker->hands[i], worker->strengths[i], shared_board_strength);
+        }
+        ++(worker->num_hands_by_hand_rank[worker->strengths[i] / HAND_RANK_WEIGHT]);
+        if (worker->batch_strengths[i] != worker->strengths[i]) {
+            if (worker->num_mismatches++ == 0) {
+                report_validation_mismatch(batch_hand_evaluation_kernel_names[batch_hand_evaluation_kernel], worker->hands[i], worker->strengths[i], worker->batch_strengths[i]);
+            }
+        }
+    }
+
+    if (worker->num_cards == HAND_LENGTH) {
+        // hand_strength takes the cards sorted by rank
+        start = get_time_in_seconds();
+        for (i = 0; i < worker->num_hands_in_batch; ++i) {
+            Hand hand;
+            hand.count = get_cards_from_card_mask(worker->hands[i], hand.cards);
+            sort_hand(&hand);
+            uint32_t strength = hand_strength(hand.cards);
+            if (strength != worker->strengths[i] && worker->num_mismatches++ == 0) {
+                report_validation_mismatch("hand_strength", worker->hands[i], strength, worker->strengths[i]);
+            }
+        }
+        worker->hand_strength_seconds += get_time_in_seconds() - start;
+    }
+    else {
+        start = get_time_in_seconds();
+        for (i = (BRUTE_FORCE_VALIDATION_STRIDE - worker->num_hands % BRUTE_FORCE_VALIDATION_STRIDE) % BRUTE_FORCE_VALIDATION_STRIDE; i < worker->num_hands_in_batch; i += BRUTE_FORCE_VALIDATION_STRIDE) {
+            uint32_t strength = get_player_strongest_hand_by_brute_force(worker->hands[i], 0);
+            ++(worker->num_brute_force_checks);
+            if (strength != worker->strengths[i] && worker->num_mismatches++ == 0) {
+                report_validation_mismatch("brute force", worker->hands[i], strength, worker->strengths[i]);
+            }
+        }
+        worker->brute_force_seconds += get_time_in_seconds() - start;
+    }
+    worker->num_hands += worker->num_hands_in_batch;
+    worker->num_hands_in_batch = 0;
+}
+
+void add_validation_hand(ValidationWorker* worker, CardMask hand) {
+    worker->hands[(worker->num_hands_in_batch)++] = hand;
+    if (worker->num_hands_in_batch == VALIDATION_BATCH_SIZE) {
+        validate_batch(worker);
+    }
+}
+
+// Every hand of num_cards - 1 cards below the highest card, plus the highest card
+void enumerate_validation_hands(ValidationWorker* worker, uint8_t num_cards, uint8_t max_card_index, CardMask hand) {
+    if (num_cards == 0) {
+        add_validation_hand(worker, hand);
+        return;
+    }
+    for (uint8_t card_index = num_cards - 1; card_index < max_card_index; ++card_index) {
+        enumerate_validation_hands(worker, num_cards - 1, card_index, hand | ((CardMask) 1 << card_index));
+    }
+}
+
+void* run_validation_worker(void* argument) {
+    ValidationWorker* worker = argument;
+    while (true) {
+        pthread_mutex_lock(worker->lock);
+        uint8_t highest_card_index = (*worker->next_highest_card_index)++;
+        pthread_mutex_unlock(worker->lock);
+        if (highest_card_index >= STANDARD_DECK_SIZE) {
+            break;
+        }
+        enumerate_validation_hands(worker, worker->num_cards - 1, highest_card_index, (CardMask) 1 << highest_card_index);
+    }
+    if (worker->num_hands_in_batch > 0) {
+        validate_batch(worker);
+    }
+    return NULL;
+}
+
+// Returns false on any mismatch or wrong hand rank count
+bool validate_evaluators_on_all_hands(uint8_t num_cards, const uint64_t* expected_num_hands_by_hand_rank) {
+    uint16_t num_workers = num_threads;
+    ValidationWorker* workers = calloc(num_workers, sizeof(ValidationWorker));
+    pthread_t* threads = malloc(num_workers * sizeof(pthread_t));
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    // the lowest highest card of a hand is its num_cards-th card
+    uint8_t next_highest_card_index = num_cards - 1;
+
+    double start = get_time_in_seconds();
+    uint16_t i;
+    for (i = 0; i < num_workers; ++i) {
+        workers[i].num_cards = num_cards;
+        workers[i].lock = &lock;
+        workers[i].next_highest_card_index = &next_highest_card_index;
+        pthread_create(&threads[i], NULL, run_validation_worker, &workers[i]);
+    }
+    ValidationWorker total;
+    memset(&total, 0, sizeof(total));
+    for (i = 0; i < num_workers; ++i) {
+        pthread_join(threads[i], NULL);
+        for (uint8_t hand_rank = NOTHING; hand_rank < NUM_HAND_RANKS; ++hand_rank) {
+            total.num_hands_by_hand_rank[hand_rank] += workers[i].num_hands_by_hand_rank[hand_rank];
+        }
+        total.num_hands += workers[i].num_hands;
+        total.num_mismatches += workers[i].num_mismatches;
+        total.num_brute_force_checks += workers[i].num_brute_force_checks;
+        total.hand_strength_seconds += workers[i].hand_strength_seconds;
+        total.lookup_table_seconds += workers[i].lookup_table_seconds;
+        total.batch_kernel_seconds += workers[i].batch_kernel_seconds;
+        total.brute_force_seconds += workers[i].brute_force_seconds;
+    }
+    double elapsed = get_time_in_seconds() - start;
+
+    bool res = total.num_mismatches == 0;
+    printf("%d-card hands: %llu in %.2f seconds with %d threads\n", num_cards, (unsigned long long) total.num_hands, elapsed, num_workers);
+    for (uint8_t hand_rank = NOTHING; hand_rank < NUM_HAND_RANKS; ++hand_rank) {
+        bool is_count_right = total.num_hands_by_hand_rank[hand_rank] == expected_num_hands_by_hand_rank[hand_rank];
+        printf("  %-16s %10llu %s\n", hand_rank_names[hand_rank], (unsigned long long) total.num_hands_by_hand_rank[hand_rank], is_count_right == true ? "ok" : "WRONG");
+        if (is_count_right == false) {
+            res = false;
+        }
+    }
+    // per thread, so the rates are those of one core
+    if (num_cards == HAND_LENGTH) {
+        printf("  hand_strength  %12.0f evaluations/sec per thread\n", total.num_hands / total.hand_strength_seconds);
+    }
+    else {
+        printf("  brute force    %12.0f evaluations/sec per thread (%llu hands checked)\n", total.num_brute_force_checks / total.brute_force_seconds, (unsigned long long) total.num_brute_force_checks);
+    }
+    printf("  lookup tables  %12.0f evaluations/sec per thread\n", total.num_hands / total.lookup_table_seconds);
+    printf("  %-14s %12.0f evaluations/sec per thread\n", batch_hand_evaluation_kernel_names[batch_hand_evaluation_kernel], total.num_hands / total.batch_kernel_seconds);
+    printf("  %llu mismatches\n", (unsigned long long) total.num_mismatches);
+
+    free(workers);
+    free(threads);
+    return res;
+}
+
+bool validate_evaluators() {
+    bool is_five_card_validation_passed = validate_evaluators_on_all_hands(HAND_LENGTH, num_five_card_hands_by_hand_rank);
+    bool is_seven_card_validation_passed = validate_evaluators_on_all_hands(HAND_LENGTH + NUM_HOLE_CARDS_PER_PLAYER, num_seven_card_hands_by_hand_rank);
+    return is_five_card_validation_passed == true && is_seven_card_validation_passed == true;
+}
+
+// #############################################
+// Benchmark suite
+// #############################################
+
+// Times each stage of the hot path on fixed-seed inputs, and prints one CSV or JSON record per measurement.
+// With a baseline file (the output of an earlier run, in either format), measurements slower than the baseline
+// by more than the threshold, a fraction of the baseline's time (--regression-threshold=0.1 for 10%), are reported as
+// regressions.
+
+#define CSV_FORMAT 0
+#define JSON_FORMAT 1
+
+#define BENCHMARK_SEED 20240101
+#define MIN_BENCHMARK_SECONDS 0.05
+#define NUM_BENCHMARK_REPETITIONS 3
+#define NUM_BENCHMARK_INPUTS 4096
+#define NUM_BENCHMARK_SIMULATION_TRIALS 10000
+#define MAX_NUM_BENCHMARK_RESULTS 256
+#define DEFAULT_REGRESSION_THRESHOLD 0.1
+
+uint8_t benchmark_format_option = CSV_FORMAT;
+const char* benchmark_baseline_option = NULL;
+double regression_threshold_option = DEFAULT_REGRESSION_THRESHOLD;
+
+typedef struct {
+    char name[64];
+    // "preflop", "flop", "turn", "river" or "" when it doesn't apply
+    char street[8];
+    // 0 when it doesn't apply
+    uint8_t num_players;
+    // what one operation is: "call", "card" or "trial"
+    char operation[8];
+    double nanoseconds_per_operation;
+} BenchmarkResult;
+
+typedef struct {
+    BenchmarkResult results[MAX_NUM_BENCHMARK_RESULTS];
+    uint16_t count;
+} BenchmarkResults;
+
+const char* street_names[] = { "preflop", "", "", "flop", "turn", "river" };
+
+// Inputs shared by the stages, all dealt from the fixed seed
+typedef struct {
+    RandomNumberGenerator random_number_generator;
+    Hand hands[NUM_BENCHMARK_INPUTS];
+    CardMask players_hole_cards[NUM_BENCHMARK_INPUTS][MAX_NUM_PLAYERS];
+    CardMask community_cards[NUM_BENCHMARK_INPUTS];
+    uint8_t num_players;
+    uint8_t num_community_cards;
+    Game game;
+    StoppingRule stopping_rule;
+    WinningProbabilityDistribution winning_probability_distribution;
+    uint64_t checksum;
+} BenchmarkContext;
+
+typedef void (*BenchmarkStage)(BenchmarkContext* context, uint64_t num_operations);
+
+void run_get_shuffled_deck_stage(BenchmarkContext* context, uint64_t num_operations) {
+    for (uint64_t i = 0; i < num_operations; ++i) {
+        Deck deck = get_shuffled_deck(&original_unshuffled_standard_deck, &context->random_number_generator);
+        context->checksum += deck.cards[0].rank;
+    }
+}
+
+void run_deal_card_stage(BenchmarkContext* context, uint64_t num_operations) {
+    Deck deck = original_unshuffled_standard_deck;
+    HoleCards hole_cards = init_hole_cards();
+    for (uint64_t i = 0; i < num_operations; ++i) {
+        if (hole_cards.count == NUM_HOLE_CARDS_PER_PLAYER) {
+            context->checksum += hole_cards.mask;
+            hole_cards = init_hole_cards();
+        }
+        if (deck.count == 0) {
+            deck = original_unshuffled_standard_deck;
+        }
+        deal_card(&deck, hole_cards.cards, &hole_cards.count, &hole_cards.mask);
+    }
+}
+
+// Pops cards from the middle of the deck, which shifts the cards after them
+void run_pop_and_append_card_stage(BenchmarkContext* context, uint64_t num_operations) {
+    Deck deck = original_unshuffled_standard_deck;
+    HoleCards hole_cards = init_hole_cards();
+    for (uint64_t i = 0; i < num_operations; ++i) {
+        if (hole_cards.count == NUM_HOLE_CARDS_PER_PLAYER) {
+            context->checksum += hole_cards.mask;
+            hole_cards = init_hole_cards();
+        }
+        if (deck.count == 0) {
+            deck = original_unshuffled_standard_deck;
+        }
+        pop_and_append_card(deck.cards, &deck.count, &deck.mask, deck.count / 2, hole_cards.cards, &hole_cards.count, &hole_cards.mask);
+    }
+}
+
+void run_hand_strength_stage(BenchmarkContext* context, uint64_t num_operations) {
+    for (uint64_t i = 0; i < num_operations; ++i) {
+        context->checksum += hand_strength(context->hands[i % NUM_BENCHMARK_INPUTS].cards);
+    }
+}
+
+void run_brute_force_evaluator_stage(BenchmarkContext* context, uint64_t num_operations) {
+    for (uint64_t i = 0; i < num_operations; ++i) {
+        context->checksum += get_player_strongest_hand_by_brute_force(context->players_hole_cards[i % NUM_BENCHMARK_INPUTS][0], context->community_cards[i % NUM_BENCHMARK_INPUTS]);
+    }
+}
+
+void run_lookup_table_evaluator_stage(BenchmarkContext* context, uint64_t num_operations) {
+    for (uint64_t i = 0; i < num_operations; ++i) {
+        context->checksum += get_player_strongest_hand_from_lookup_tables(context->players_hole_cards[i % NUM_BENCHMARK_INPUTS][0], context->community_cards[i % NUM_BENCHMARK_INPUTS]);
+    }
+}
+
+void run_set_players_equities_stage(BenchmarkContext* context, uint64_t num_operations) {
+    double players_equities[MAX_NUM_PLAYERS];
+    for (uint64_t i = 0; i < num_operations; ++i) {
+        set_players_equities(players_equities, context->players_hole_cards[i % NUM_BENCHMARK_INPUTS], context->num_players, context->community_cards[i % NUM_BENCHMARK_INPUTS]);
+        context->checksum += players_equities[0] > 0;
+    }
+}
+
+void run_set_winning_probability_distribution_stage(BenchmarkContext* context, uint64_t num_operations) {
+    for (uint64_t i = 0; i < num_operations; ++i) {
+        set_winning_probability_distribution(&context->game, &context->winning_probability_distribution, &context->stopping_rule);
+        context->checksum += context->winning_probability_distribution.num_trials;
+    }
+}
+
+// Deals the hole cards of num_players players and num_community_cards community cards for every input
+void deal_benchmark_inputs(BenchmarkContext* context, uint8_t num_players, uint8_t num_community_cards) {
+    context->num_players = num_players;
+    context->num_community_cards = num_community_cards;
+    Deck deck = get_unshuffled_standard_deck();
+    for (uint16_t i = 0; i < NUM_BENCHMARK_INPUTS; ++i) {
+        draw_random_cards(&deck, num_players * NUM_HOLE_CARDS_PER_PLAYER + num_community_cards, &context->random_number_generator);
+        for (uint8_t j = 0; j < num_players; ++j) {
+            context->players_hole_cards[i][j] = get_card_mask(&deck.cards[2 * j]) | get_card_mask(&deck.cards[2 * j + 1]);
+        }
+        context->community_cards[i] = 0;
+        for (uint8_t j = 0; j < num_community_cards; ++j) {
+            context->community_cards[i] |= get_card_mask(&deck.cards[num_players * NUM_HOLE_CARDS_PER_PLAYER + j]);
+        }
+    }
+}
+
+// Best of the repetitions, each of them doubling the number of operations until it lasts long enough to time
+double get_nanoseconds_per_operation(BenchmarkStage stage, BenchmarkContext* context) {
+    double res = 0;
+    for (uint8_t repetition = 0; repetition < NUM_BENCHMARK_REPETITIONS; ++repetition) {
+        uint64_t num_operations = 16;
+        while (true) {
+            double start = get_time_in_seconds();
+            stage(context, num_operations);
+            double elapsed = get_time_in_seconds() - start;
+            if (elapsed >= MIN_BENCHMARK_SECONDS) {
+                double nanoseconds_per_operation = elapsed * 1e9 / num_operations;
+                if (repetition == 0 || nanoseconds_per_operation < res) {
+                    res = nanoseconds_per_operation;
+                }
+                break;
+            }
+            num_operations *= 2;
+        }
+    }
+    return res;
+}
+
+void add_benchmark_result(BenchmarkResults* results, const char* name, const char* street, uint8_t num_players, const char* operation, double nanoseconds_per_operation) {
+    if (results->count == MAX_NUM_BENCHMARK_RESULTS) {
+        return;
+    }
+    BenchmarkResult* result = &results->results[(results->count)++];
+    snprintf(result->name, sizeof(result->name), "%s", name);
+    snprintf(result->street, sizeof(result->street), "%s", street);
+    result->num_players = num_players;
+    snprintf(result->operation, sizeof(result->operation), "%s", operation);
+    result->nanoseconds_per_operation = nanoseconds_per_operation;
+    fprintf(stderr, "%-48s %-7s %2d players %12.1f ns/%s\n", name, street, num_players, nanoseconds_per_operation, operation);
+}
+
+void run_benchmark_stages(BenchmarkResults* results) {
+    static BenchmarkContext context;
+    context.random_number_generator = init_random_number_generator(random_number_generator_algorithm, BENCHMARK_SEED, 0);
+    context.checksum = 0;
+    results->count = 0;
+
+    add_benchmark_result(results, "get_shuffled_deck", "", 0, "call", get_nanoseconds_per_operation(run_get_shuffled_deck_stage, &context));
+    add_benchmark_result(results, "deal_card", "", 0, "card", get_nanoseconds_per_operation(run_deal_card_stage, &context));
+    add_benchmark_result(results, "pop_and_append_card", "", 0, "card", get_nanoseconds_per_operation(run_pop_and_append_card_stage, &context));
+
+    deal_benchmark_inputs(&context, 1, HAND_LENGTH - NUM_HOLE_CARDS_PER_PLAYER);
+    for (uint16_t i = 0; i < NUM_BENCHMARK_INPUTS; ++i) {
+        context.hands[i].count = get_cards_from_card_mask(context.players_hole_cards[i][0] | context.community_cards[i], context.hands[i].cards);
+        sort_hand(&context.hands[i]);
+    }
+    add_benchmark_result(results, "hand_strength", "", 0, "call", get_nanoseconds_per_operation(run_hand_strength_stage, &context));
+
+    for (uint8_t num_community_cards = 3; num_community_cards <= MAX_NUM_COMMUNITY_CARDS; ++num_community_cards) {
+        deal_benchmark_inputs(&context, 1, num_community_cards);
+        // the brute force evaluator only takes 7 cards
+        if (num_community_cards == MAX_NUM_COMMUNITY_CARDS) {
+            add_benchmark_result(results, "get_player_strongest_hand/brute-force", street_names[num_community_cards], 0, "call", get_nanoseconds_per_operation(run_brute_force_evaluator_stage, &context));
+        }
+        add_benchmark_result(results, "get_player_strongest_hand/lookup-tables", street_names[num_community_cards], 0, "call", get_nanoseconds_per_operation(run_lookup_table_evaluator_stage, &context));
+    }
+
+    uint8_t num_players;
+    for (num_players = MIN_NUM_PLAYERS; num_players <= MAX_NUM_PLAYERS; ++num_players) {
+        deal_benchmark_inputs(&context, num_players, MAX_NUM_COMMUNITY_CARDS);
+        add_benchmark_result(results, "set_players_equities", "river", num_players, "call", get_nanoseconds_per_operation(run_set_players_equities_stage, &context));
+    }
+
+    // Full simulations of fixed spots with a fixed number of trials, each street with all the hole cards known
+    context.stopping_rule = init_stopping_rule();
+    context.stopping_rule.max_num_trials = NUM_BENCHMARK_SIMULATION_TRIALS;
+    RandomNumberGenerator saved_random_number_generator = main_random_number_generator;
+    main_random_number_generator = init_random_number_generator(random_number_generator_algorithm, BENCHMARK_SEED, 1);
+    for (uint8_t num_community_cards = 0; num_community_cards < MAX_NUM_COMMUNITY_CARDS; num_community_cards += num_community_cards == 0 ? 3 : 1) {
+        for (num_players = MIN_NUM_PLAYERS; num_players <= MAX_NUM_PLAYERS; ++num_players) {
+            context.game = init_game(&num_players);
+            context.game.deck = get_shuffled_deck(&original_unshuffled_standard_deck, &main_random_number_generator);
+            deal_hole_cards(&context.game.players, &context.game.deck);
+            for (uint8_t i = 0; i < num_community_cards; ++i) {
+                deal_community_card(&context.game.community_cards, &context.game.deck);
+            }
+            double nanoseconds_per_call = get_nanoseconds_per_operation(run_set_winning_probability_distribution_stage, &context);
+            const char* name = context.winning_probability_distribution.method == EXACT_ENUMERATION ? "set_winning_probability_distribution/exact" : "set_winning_probability_distribution/monte-carlo";
+            add_benchmark_result(results, name, street_names[num_community_cards], num_players, "trial", nanoseconds_per_call / context.winning_probability_distribution.num_trials);
+        }
+    }
+    main_random_number_generator = saved_random_number_generator;
+    fprintf(stderr, "(checksum %llu)\n", (unsigned long long) context.checksum);
+}
+
+void print_benchmark_results(BenchmarkResults* results, uint8_t format) {
+    if (format == CSV_FORMAT) {
+        printf("name,street,players,operation,nanoseconds_per_operation\n");
+    }
+    else {
+        printf("[\n");
+    }
+    for (uint16_t i = 0; i < results->count; ++i) {
+        BenchmarkResult* result = &results->results[i];
+        if (format == CSV_FORMAT) {
+            printf("%s,%s,%d,%s,%.3f\n", result->name, result->street, result->num_players, result->operation, result->nanoseconds_per_operation);
+        }
+        else {
+            printf("{\"name\":\"%s\",\"street\":\"%s\",\"players\":%d,\"operation\":\"%s\",\"nanoseconds_per_operation\":%.3f}%s\n", result->name, result->street, result->num_players, result->operation, result->nanoseconds_per_operation, i + 1 < results->count ? "," : "");
+        }
+    }
+    if (format == JSON_FORMAT) {
+        printf("]\n");
+    }
+}
+
+// Reads one record of a CSV or JSON results file (as printed by print_benchmark_results), or returns false
+bool parse_benchmark_result(const char* line, BenchmarkResult* result) {
+    if (sscanf(line, " {\"name\":\"%63[^\"]\",\"street\":\"%7[^\"]\",\"players\":%hhu,\"operation\":\"%7[^\"]\",\"nanoseconds_per_operation\":%lf", result->name, result->street, &result->num_players, result->operation, &result->nanoseconds_per_operation) == 5) {
+        return true;
+    }
+    if (sscanf(line, " {\"name\":\"%63[^\"]\",\"street\":\"\",\"players\":%hhu,\"operation\":\"%7[^\"]\",\"nanoseconds_per_operation\":%lf", result->name, &result->num_players, result->operation, &result->nanoseconds_per_operation) == 4) {
+        result->street[0] = '\0';
+        return true;
+    }
+    if (sscanf(line, "%63[^,],%7[^,],%hhu,%7[^,],%lf", result->name, result->street, &result->num_players, result->operation, &result->nanoseconds_per_operation) == 5) {
+        return true;
+    }
+    if (sscanf(line, "%63[^,],,%hhu,%7[^,],%lf", result->name, &result->num_players, result->operation, &result->nanoseconds_per_operation) == 4) {
+        result->street[0] = '\0';
+        return true;
+    }
+    return false;
+}
+
+// Reports every measurement slower than its baseline by more than the threshold; returns false if any is
+bool compare_benchmark_results_with_baseline(BenchmarkResults* results, const char* baseline_path, double threshold) {
+    FILE* baseline = fopen(baseline_path, "r");
+    if (baseline == NULL) {
+        perror(baseline_path);
+        return false;
+    }
+    static BenchmarkResults baseline_results;
+    baseline_results.count = 0;
+    char line[512];
+    while (fgets(line, sizeof(line), baseline) != NULL && baseline_results.count < MAX_NUM_BENCHMARK_RESULTS) {
+        if (parse_benchmark_result(line, &baseline_results.results[baseline_results.count]) == true) {
+            ++(baseline_results.count);
+        }
+    }
+    fclose(baseline);
+
+    uint16_t num_regressions = 0;
+    uint16_t num_compared_results = 0;
+    for (uint16_t i = 0; i < results->count; ++i) {
+        BenchmarkResult* result = &results->results[i];
+        for (uint16_t j = 0; j < baseline_results.count; ++j) {
+            BenchmarkResult* baseline_result = &baseline_results.results[j];
+            if (strcmp(result->name, baseline_result->name) != 0 || strcmp(result->street, baseline_result->street) != 0 || result->num_players != baseline_result->num_players) {
+                continue;
+            }
+            ++num_compared_results;
+            double ratio = result->nanoseconds_per_operation / baseline_result->nanoseconds_per_operation;
+            if (ratio > 1 + threshold) {
+                ++num_regressions;
+                fprintf(stderr, "REGRESSION %-48s %-7s %2d players %12.1f ns/%s (baseline %.1f, %+.1f%%)\n", result->name, result->street, result->num_players, result->nanoseconds_per_operation, result->operation, baseline_result->nanoseconds_per_operation, (ratio - 1) * 100);
+            }
+            break;
+        }
+    }
+    fprintf(stderr, "%d of %d measurements compared with %s regressed by more than %g%%\n", num_regressions, num_compared_results, baseline_path, threshold * 100);
+    return num_regressions == 0;
+}
+
+bool run_benchmark_suite() {
+    static BenchmarkResults results;
+    run_benchmark_stages(&results);
+    print_benchmark_results(&results, benchmark_format_option);
+    if (benchmark_baseline_option != NULL) {
+        return compare_benchmark_results_with_baseline(&results, benchmark_baseline_option, regression_threshold_option);
+    }
+    return true;
+}
+
+// #############################################
+// Batch queries
+// #############################################
+
+// The batch mode reads one spot per line, like "id=a hole=AhKd board=QsJs2d players=6", with the optional
+// settings range= (once per opponent with a range), max_trials=, target_standard_error= and deadline_ms=
+// (after which the estimate so far is returned). Reading, simulating
+// and writing run in separate threads: every simulation thread takes whole spots (with one simulation thread each),
+// and the JSON lines results come out in the input order.
+
+#define BATCH_QUEUE_CAPACITY 1024
+#define MAX_BATCH_LINE_LENGTH 1024
+#define MAX_BATCH_ID_LENGTH 64
+
+typedef struct {
+    uint64_t line_number;
+    char id[MAX_BATCH_ID_LENGTH];
+    Game game;
+    // NULL without ranges
+    Range* ranges;
+    StoppingRule stopping_rule;
+    // empty unless the spot is invalid
+    char error[256];
+    WinningProbabilityDistribution winning_probability_distribution;
+    bool is_from_preflop_equity_database;
+    bool is_simulated;
+} BatchSpot;
+
+// Spots go through the ring of spots in order: read, then taken by a simulation thread, then written
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t spots_changed;
+    BatchSpot* spots;
+    uint64_t num_spots_read;
+    uint64_t num_spots_taken;
+    uint64_t num_spots_written;
+    bool is_input_done;
+} BatchQueue;
+
+// Sets up the spot from a line of "name=value" settings; returns false for a blank line
+bool parse_batch_spot(char* line, uint64_t line_number, BatchSpot* spot) {
+    spot->line_number = line_number;
+    spot->id[0] = '\0';
+    spot->ranges = NULL;
+    spot->stopping_rule = stopping_rule_option;
+    spot->error[0] = '\0';
+    spot->is_from_preflop_equity_database = false;
+    spot->is_simulated = false;
+
+    const char* hero = NULL;
+    const char* community_cards = NULL;
+    const char* opponents_ranges[MAX_NUM_PLAYERS - 1];
+    uint8_t num_opponents_ranges = 0;
+    uint8_t num_players = MIN_NUM_PLAYERS;
+    bool is_blank = true;
+    char* position;
+    for (char* setting = strtok_r(line, " \t\r\n", &position); setting != NULL; setting = strtok_r(NULL, " \t\r\n", &position)) {
+        is_blank = false;
+        char* value = strchr(setting, '=');
+        if (value == NULL) {
+            snprintf(spot->error, sizeof(spot->error), "expected name=value: %s", setting);
+            return true;
+        }
+        *(value++) = '\0';
+        if (strcmp(setting, "id") == 0) {
+            snprintf(spot->id, sizeof(spot->id), "%s", value);
+        }
+        else if (strcmp(setting, "hole") == 0) {
+            hero = value;
+        }
+        else if (strcmp(setting, "board") == 0) {
+            community_cards = value;
+        }
+        else if (strcmp(setting, "players") == 0) {
+            int requested_num_players = atoi(value);
+            if (requested_num_players < MIN_NUM_PLAYERS || requested_num_players > MAX_NUM_PLAYERS) {
+                snprintf(spot->error, sizeof(spot->error), "the number of players must be between %d and %d", MIN_NUM_PLAYERS, MAX_NUM_PLAYERS);
+                return true;
+            }
+            num_players = requested_num_players;
+        }
+        else if (strcmp(setting, "range") == 0) {
+            if (num_opponents_ranges == MAX_NUM_PLAYERS - 1) {
+                snprintf(spot->error, sizeof(spot->error), "at most %d opponents can have a range", MAX_NUM_PLAYERS - 1);
+                return true;
+            }
+            opponents_ranges[num_opponents_ranges++] = value;
+        }
+        else if (strcmp(setting, "max_trials") == 0 && atoll(value) > 0) {
+            spot->stopping_rule.max_num_trials = atoll(value);
+        }
+        else if (strcmp(setting, "target_standard_error") == 0 && atof(value) > 0) {
+            spot->stopping_rule.target_standard_error = atof(value);
+        }
+        else if (strcmp(setting, "deadline_ms") == 0 && atof(value) > 0) {
+            spot->stopping_rule.max_num_seconds = atof(value) / 1000;
+        }
+        else {
+            snprintf(spot->error, sizeof(spot->error), "unexpected setting: %s=%s", setting, value);
+            return true;
+        }
+    }
+    if (is_blank == true) {
+        return false;
+    }
+    if (hero == NULL) {
+        snprintf(spot->error, sizeof(spot->error), "missing hole=");
+        return true;
+    }
+    Card hole_cards[NUM_HOLE_CARDS_PER_PLAYER];
+    if (num_opponents_ranges > 0 || parse_cards(hero, hole_cards, NUM_HOLE_CARDS_PER_PLAYER) != NUM_HOLE_CARDS_PER_PLAYER) {
+        spot->ranges = malloc((num_opponents_ranges + 1) * sizeof(Range));
+    }
+    if (init_spot(&spot->game, spot->ranges, hero, community_cards, opponents_ranges, num_opponents_ranges, num_players, spot->error, sizeof(spot->error)) == false) {
+        free(spot->ranges);
+        spot->ranges = NULL;
+    }
+    return true;
+}
+
+// Reads the next line of input; a line too long for MAX_BATCH_LINE_LENGTH is cut there, the rest of it skipped and
+// is_too_long set. Returns false at the end of the input.
+bool read_batch_line(FILE* input, char* line, bool* is_too_long) {
+    if (fgets(line, MAX_BATCH_LINE_LENGTH, input) == NULL) {
+        return false;
+    }
+    *is_too_long = strchr(line, '\n') == NULL && feof(input) == false;
+    if (*is_too_long == true) {
+        int character;
+        while ((character = fgetc(input)) != '\n' && character != EOF) {
+        }
+    }
+    return true;
+}
+
+// Same as parse_batch_spot, except that a line that was too long is always a spot, answered with an error (and its id,
+// if the part that was read has it)
+bool parse_batch_line(char* line, bool is_too_long, uint64_t line_number, BatchSpot* spot) {
+    bool res = parse_batch_spot(line, line_number, spot);
+    if (is_too_long == true) {
+        // the spot is never simulated, so nothing else frees its ranges
+        free(spot->ranges);
+        spot->ranges = NULL;
+        snprintf(spot->error, sizeof(spot->error), "the line is longer than %d characters", MAX_BATCH_LINE_LENGTH - 2);
+        res = true;
+    }
+    return res;
+}
+
+void simulate_batch_spot(BatchSpot* spot) {
+    if (spot->error[0] != '\0') {
+        return;
+    }
+    Players* players = &spot->game.players;
+    if (spot->game.community_cards.count == 0 && players->hole_cards[0].count == NUM_HOLE_CARDS_PER_PLAYER && get_num_players_with_unknown_hole_cards(players) == players->count - 1 && get_num_players_with_ranges(players) == 0) {
+        const PreflopEquityDatabaseEntry* entry = get_preflop_equity(players->hole_cards[0].cards, players->count);
+        if (entry != NULL && does_preflop_equity_meet_stopping_rule(entry, &spot->stopping_rule) == true) {
+            spot->winning_probability_distribution.equities[0] = entry->win_equity + entry->tie_equity;
+            spot->winning_probability_distribution.tie_equities[0] = entry->tie_equity;
+            spot->winning_probability_distribution.standard_errors[0] = entry->standard_error;
+            spot->winning_probability_distribution.num_trials = entry->num_trials;
+            spot->is_from_preflop_equity_database = true;
+            return;
+        }
+    }
+    if (set_cached_winning_probability_distribution(&spot->game, &spot->winning_probability_distribution, &spot->stopping_rule) == false) {
+        snprintf(spot->error, sizeof(spot->error), "the ranges can't be dealt together");
+    }
+    free(spot->ranges);
+    spot->ranges = NULL;
+}
+
+void print_json_string(FILE* output, const char* text) {
+    fputc('"', output);
+    for (; *text != '\0'; ++text) {
+        if (*text == '"' || *text == '\\') {
+            fprintf(output, "\\%c", *text);
+        }
+        else if ((unsigned char) *text < ' ') {
+            fprintf(output, "\\u%04x", *text);
+        }
+        else {
+            fputc(*text, output);
+        }
+    }
+    fputc('"', output);
+}
+
+void write_batch_spot(BatchSpot* spot, FILE* output) {
+    fprintf(output, "{\"line\":%llu", (unsigned long long) spot->line_number);
+    if (spot->id[0] != '\0') {
+        fprintf(output, ",\"id\":");
+        print_json_string(output, spot->id);
+    }
+    if (spot->error[0] != '\0') {
+        fprintf(output, ",\"error\":");
+        print_json_string(output, spot->error);
+        fprintf(output, "}\n");
+        return;
+    }
+    WinningProbabilityDistribution* winning_probability_distribution = &spot->winning_probability_distribution;
+    const char* source = winning_probability_distribution->method == EXACT_ENUMERATION ? "exact" : "monte-carlo";
+    if (spot->is_from_preflop_equity_database == true) {
+        source = "preflop-database";
+    }
+    else if (winning_probability_distribution->is_cached == true) {
+        source = "cache";
+    }
+    double equity = winning_probability_distribution->equities[0];
+    double tie_equity = winning_probability_distribution->tie_equities[0];
+    fprintf(output, ",\"equity\":%.6f,\"win\":%.6f,\"tie\":%.6f,\"standard_error\":%.6f,\"trials\":%llu,\"source\":\"%s\"}\n", equity, equity - tie_equity, tie_equity, winning_probability_distribution->standard_errors[0], (unsigned long long) winning_probability_distribution->num_trials, source);
+}
+
+void* run_batch_simulation_thread(void* argument) {
+    BatchQueue* queue = argument;
+    pthread_mutex_lock(&queue->lock);
+    while (true) {
+        while (queue->num_spots_taken == queue->num_spots_read && queue->is_input_done == false) {
+            pthread_cond_wait(&queue->spots_changed, &queue->lock);
+        }
+        if (queue->num_spots_taken == queue->num_spots_read) {
+            break;
+        }
+        BatchSpot* spot = &queue->spots[(queue->num_spots_taken)++ % BATCH_QUEUE_CAPACITY];
+        pthread_mutex_unlock(&queue->lock);
+
+        simulate_batch_spot(spot);
+
+        pthread_mutex_lock(&queue->lock);
+        spot->is_simulated = true;
+        pthread_cond_broadcast(&queue->spots_changed);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return NULL;
+}
+
+void* run_batch_writing_thread(void* argument) {
+    BatchQueue* queue = argument;
+    pthread_mutex_lock(&queue->lock);
+    while (true) {
+        while (queue->num_spots_written == queue->num_spots_read || queue->spots[queue->num_spots_written % BATCH_QUEUE_CAPACITY].is_simulated == false) {
+            if (queue->num_spots_written == queue->num_spots_read && queue->is_input_done == true) {
+                pthread_mutex_unlock(&queue->lock);
+                fflush(stdout);
+                return NULL;
+            }
+            // the results so far are out before waiting for the next one
+            fflush(stdout);
+            pthread_cond_wait(&queue->spots_changed, &queue->lock);
+        }
+        BatchSpot* spot = &queue->spots[queue->num_spots_written % BATCH_QUEUE_CAPACITY];
+        pthread_mutex_unlock(&queue->lock);
+
+        write_batch_spot(spot, stdout);
+
+        pthread_mutex_lock(&queue->lock);
+        ++(queue->num_spots_written);
+        pthread_cond_broadcast(&queue->spots_changed);
+    }
+}
+
+// Answers the spots of the file (or of the standard input without one) with --threads simulation threads
+bool run_batch(const char* input_path) {
+    FILE* input = stdin;
+    if (input_path != NULL) {
+        input = fopen(input_path, "r");
+        if (input == NULL) {
+            perror(input_path);
+            return false;
+        }
+    }
+    BatchQueue queue;
+    pthread_mutex_init(&queue.lock, NULL);
+    pthread_cond_init(&queue.spots_changed, NULL);
+    queue.spots = malloc(BATCH_QUEUE_CAPACITY * sizeof(BatchSpot));
+    queue.num_spots_read = 0;
+    queue.num_spots_taken = 0;
+    queue.num_spots_written = 0;
+    queue.is_input_done = false;
+
+    // every spot gets one simulation thread, the parallelism is across spots
+    uint16_t num_simulation_threads = num_threads;
+    num_threads = 1;
+    pthread_t simulation_threads[MAX_NUM_THREADS];
+    pthread_t writing_thread;
+    uint16_t i;
+    for (i = 0; i < num_simulation_threads; ++i) {
+        pthread_create(&simulation_threads[i], NULL, run_batch_simulation_thread, &queue);
+    }
+    pthread_create(&writing_thread, NULL, run_batch_writing_thread, &queue);
+
+    double start = get_time_in_seconds();
+    char line[MAX_BATCH_LINE_LENGTH];
+    uint64_t line_number = 0;
+    bool is_too_long;
+    while (read_batch_line(input, line, &is_too_long) == true) {
+        ++line_number;
+        pthread_mutex_lock(&queue.lock);
+        while (queue.num_spots_read - queue.num_spots_written == BATCH_QUEUE_CAPACITY) {
+            pthread_cond_wait(&queue.spots_changed, &queue.lock);
+        }
+        pthread_mutex_unlock(&queue.lock);
+
+        // no other thread looks at the next spot until it is counted as read
+        BatchSpot* spot = &queue.spots[queue.num_spots_read % BATCH_QUEUE_CAPACITY];
+        if (parse_batch_line(line, is_too_long, line_number, spot) == true) {
+            pthread_mutex_lock(&queue.lock);
+            ++(queue.num_spots_read);
+            pthread_cond_broadcast(&queue.spots_changed);
+            pthread_mutex_unlock(&queue.lock);
+        }
+    }
+    pthread_mutex_lock(&queue.lock);
+    queue.is_input_done = true;
+    pthread_cond_broadcast(&queue.spots_changed);
+    pthread_mutex_unlock(&queue.lock);
+
+    for (i = 0; i < num_simulation_threads; ++i) {
+        pthread_join(simulation_threads[i], NULL);
+    }
+    pthread_join(writing_thread, NULL);
+    double elapsed = get_time_in_seconds() - start;
+    fprintf(stderr, "%llu spots in %.3f seconds (%.0f spots/sec)\n", (unsigned long long) queue.num_spots_read, elapsed, queue.num_spots_read / elapsed);
+
+    num_threads = num_simulation_threads;
+    free(queue.spots);
+    pthread_cond_destroy(&queue.spots_changed);
+    pthread_mutex_destroy(&queue.lock);
+    if (input != stdin) {
+        fclose(input);
+    }
+    return true;
+}
+
+// #############################################
+// Equity server
+// #############################################
+
+// The server listens on a UNIX domain socket and answers each line a client sends (a spot, as in the batch mode)
+// with a JSON line. The tables, the preflop equity database and the result cache stay warm between requests.
+// Every connection has a reader thread, which parses its requests and queues them for a fixed pool of --threads
+// threads, so idle connections never hold up the others. A connection's responses come out in the order of its
+// requests, and a request's deadline_ms counts from when its line is read, time in the queue included.
+
+#define DEFAULT_SOCKET_PATH "/tmp/texas_holdem_equity.sock"
+#define REQUEST_QUEUE_CAPACITY 1024
+// a client that doesn't read its responses for that long loses its connection, rather than a pool thread
+#define RESPONSE_SEND_TIMEOUT_SECONDS 10
+// the budget of a request whose deadline passed in the queue: it gets the quickest estimate, of a single chunk of trials
+#define MIN_REQUEST_SIMULATION_SECONDS 1e-6
+
+struct ServerRequest;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t requests_changed;
+    struct ServerRequest* requests[REQUEST_QUEUE_CAPACITY];
+    uint32_t first_request;
+    uint32_t num_requests;
+} RequestQueue;
+
+// Freed with the last of its reader and its unanswered requests
+typedef struct {
+    FILE* requests;
+    FILE* responses;
+    RequestQueue* request_queue;
+    pthread_mutex_t lock;
+    // the unanswered requests, in order: the responses are written from the first one on
+    struct ServerRequest* first_pending_request;
+    struct ServerRequest* last_pending_request;
+    // the reader and the unanswered requests
+    uint32_t num_references;
+    // set once a response can't be written, after which the responses are dropped
+    bool is_broken;
+} ServerConnection;
+
+typedef struct ServerRequest {
+    BatchSpot spot;
+    ServerConnection* connection;
+    double arrival_time;
+    bool is_simulated;
+    struct ServerRequest* next_pending_request;
+} ServerRequest;
+
+void close_server_connection(ServerConnection* connection) {
+    fclose(connection->requests);
+    fclose(connection->responses);
+    pthread_mutex_destroy(&connection->lock);
+    free(connection);
+}
+
+void release_server_connection(ServerConnection* connection) {
+    pthread_mutex_lock(&connection->lock);
+    bool is_last_reference = --(connection->num_references) == 0;
+    pthread_mutex_unlock(&connection->lock);
+    if (is_last_reference == true) {
+        close_server_connection(connection);
+    }
+}
+
+void push_server_request(RequestQueue* queue, ServerRequest* request) {
+    pthread_mutex_lock(&queue->lock);
+    while (queue->num_requests == REQUEST_QUEUE_CAPACITY) {
+        pthread_cond_wait(&queue->requests_changed, &queue->lock);
+    }
+    queue->requests[(queue->first_request + queue->num_requests) % REQUEST_QUEUE_CAPACITY] = request;
+    ++(queue->num_requests);
+    pthread_cond_broadcast(&queue->requests_changed);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+ServerRequest* take_server_request(RequestQueue* queue) {
+    pthread_mutex_lock(&queue->lock);
+    while (queue->num_requests == 0) {
+        pthread_cond_wait(&queue->requests_changed, &queue->lock);
+    }
+    ServerRequest* res = queue->requests[queue->first_request];
+    queue->first_request = (queue->first_request + 1) % REQUEST_QUEUE_CAPACITY;
+    --(queue->num_requests);
+    pthread_cond_broadcast(&queue->requests_changed);
+    pthread_mutex_unlock(&queue->lock);
+    return res;
+}
+
+// Marks the request as answered, and writes the connection's responses that are now next in order
+void answer_server_request(ServerRequest* request) {
+    ServerConnection* connection = request->connection;
+    pthread_mutex_lock(&connection->lock);
+    request->is_simulated = true;
+    while (connection->first_pending_request != NULL && connection->first_pending_request->is_simulated == true) {
+        ServerRequest* answered_request = connection->first_pending_request;
+        if (connection->is_broken == false) {
+            write_batch_spot(&answered_request->spot, connection->responses);
+            if (fflush(connection->responses) != 0) {
+                // the reader stops too
+                connection->is_broken = true;
+                shutdown(fileno(connection->responses), SHUT_RDWR);
+            }
+        }
+        connection->first_pending_request = answered_request->next_pending_request;
+        free(answered_request);
+        --(connection->num_references);
+    }
+    bool is_last_reference = connection->num_references == 0;
+    pthread_mutex_unlock(&connection->lock);
+    if (is_last_reference == true) {
+        close_server_connection(connection);
+    }
+}
+
+void* run_server_connection_reader(void* argument) {
+    ServerConnection* connection = argument;
+    char line[MAX_BATCH_LINE_LENGTH];
+    uint64_t line_number = 0;
+    bool is_too_long;
+    while (read_batch_line(connection->requests, line, &is_too_long) == true) {
+        ++line_number;
+#ifdef PROFILE
+        // the profile of everything the server has simulated so far, as JSON
+        if (strcmp(line, "profile\n") == 0) {
+            pthread_mutex_lock(&connection->lock);
+            print_profile_report(connection->responses, JSON_PROFILE_REPORT);
+            fflush(connection->responses);
+            pthread_mutex_unlock(&connection->lock);
+            continue;
+        }
+#endif
+        ServerRequest* request = malloc(sizeof(ServerRequest));
+        if (parse_batch_line(line, is_too_long, line_number, &request->spot) == false) {
+            free(request);
+            continue;
+        }
+        request->connection = connection;
+        request->arrival_time = get_time_in_seconds();
+        request->is_simulated = false;
+        request->next_pending_request = NULL;
+        pthread_mutex_lock(&connection->lock);
+        if (connection->first_pending_request == NULL) {
+            connection->first_pending_request = request;
+        }
+        else {
+            connection->last_pending_request->next_pending_request = request;
+        }
+        connection->last_pending_request = request;
+        ++(connection->num_references);
+        pthread_mutex_unlock(&connection->lock);
+        push_server_request(connection->request_queue, request);
+    }
+    release_server_connection(connection);
+    return NULL;
+}
+
+void* run_server_thread(void* argument) {
+    RequestQueue* queue = argument;
+    while (true) {
+        ServerRequest* request = take_server_request(queue);
+        StoppingRule* stopping_rule = &request->spot.stopping_rule;
+        if (stopping_rule->max_num_seconds > 0) {
+            stopping_rule->max_num_seconds -= get_time_in_seconds() - request->arrival_time;
+            if (stopping_rule->max_num_seconds < MIN_REQUEST_SIMULATION_SECONDS) {
+                stopping_rule->max_num_seconds = MIN_REQUEST_SIMULATION_SECONDS;
+            }
+        }
+        simulate_batch_spot(&request->spot);
+        answer_server_request(request);
+    }
+    return NULL;
+}
+
+// Starts the reader of a new connection, or closes it if it can't be served
+void open_server_connection(int connection_socket, RequestQueue* request_queue) {
+    struct timeval send_timeout = { RESPONSE_SEND_TIMEOUT_SECONDS, 0 };
+    setsockopt(connection_socket, SOL_SOCKET, SO_SNDTIMEO, &send_timeout, sizeof(send_timeout));
+    ServerConnection* connection = malloc(sizeof(ServerConnection));
+    connection->requests = fdopen(connection_socket, "r");
+    connection->responses = fdopen(dup(connection_socket), "w");
+    if (connection->requests == NULL || connection->responses == NULL) {
+        if (connection->requests != NULL) {
+            fclose(connection->requests);
+        }
+        else {
+            close(connection_socket);
+        }
+        if (connection->responses != NULL) {
+            fclose(connection->responses);
+        }
+        free(connection);
+        return;
+    }
+    connection->request_queue = request_queue;
+    pthread_mutex_init(&connection->lock, NULL);
+    connection->first_pending_request = NULL;
+    connection->last_pending_request = NULL;
+    connection->num_references = 1;
+    connection->is_broken = false;
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, run_server_connection_reader, connection) != 0) {
+        release_server_connection(connection);
+        return;
+    }
+    pthread_detach(thread);
+}
+
+bool serve(const char* socket_path) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "The socket path is too long: %s\n", socket_path);
+        return false;
+    }
+    strcpy(address.sun_path, socket_path);
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        perror("socket");
+        return false;
+    }
+    // a socket file left by a previous server would make bind fail
+    unlink(socket_path);
+    if (bind(listener, (struct sockaddr*) &address, sizeof(address)) != 0 || listen(listener, SOMAXCONN) != 0) {
+        perror(socket_path);
+        close(listener);
+        return false;
+    }
+    // a client hanging up mid-response only ends its connection
+    signal(SIGPIPE, SIG_IGN);
+
+    static RequestQueue queue;
+    pthread_mutex_init(&queue.lock, NULL);
+    pthread_cond_init(&queue.requests_changed, NULL);
+    queue.first_request = 0;
+    queue.num_requests = 0;
+    // every request gets one simulation thread, the parallelism is across requests
+    uint16_t num_server_threads = num_threads;
+    num_threads = 1;
+    for (uint16_t i = 0; i < num_server_threads; ++i) {
+        pthread_t thread;
+        pthread_create(&thread, NULL, run_server_thread, &queue);
+        pthread_detach(thread);
+    }
+    fprintf(stderr, "Listening on %s with %d threads\n", socket_path, num_server_threads);
+
+    while (true) {
+        int connection_socket = accept(listener, NULL, NULL);
+        if (connection_socket >= 0) {
+            open_server_connection(connection_socket, &queue);
+        }
+    }
+}
+
+// The load generator keeps --connections connections busy with random flop spots, one request at a time on each
+#define DEFAULT_NUM_LOAD_TEST_CONNECTIONS 4
+#define DEFAULT_NUM_LOAD_TEST_REQUESTS 10000
+
+uint16_t num_load_test_connections_option = DEFAULT_NUM_LOAD_TEST_CONNECTIONS;
+uint32_t num_load_test_requests_option = DEFAULT_NUM_LOAD_TEST_REQUESTS;
+
+typedef struct {
+    const char* socket_path;
+    uint32_t first_request;
+    uint32_t end_request;
+    uint8_t num_players;
+    // latencies of all the requests, in seconds; the client's first num_completed_requests ones are set
+    double* latencies;
+    RandomNumberGenerator random_number_generator;
+    uint32_t num_completed_requests;
+    uint32_t num_errors;
+} LoadTestClient;
+
+int connect_to_server(const char* socket_path) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    snprintf(address.sun_path, sizeof(address.sun_path), "%s", socket_path);
+    int connection = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (connection >= 0 && connect(connection, (struct sockaddr*) &address, sizeof(address)) != 0) {
+        close(connection);
+        return -1;
+    }
+    return connection;
+}
+
+void* run_load_test_client(void* argument) {
+    LoadTestClient* client = argument;
+    int connection = connect_to_server(client->socket_path);
+    if (connection < 0) {
+        perror(client->socket_path);
+        client->num_errors = client->end_request - client->first_request;
+        return NULL;
+    }
+    FILE* responses = fdopen(connection, "r");
+    FILE* requests = fdopen(dup(connection), "w");
+    Deck deck = get_unshuffled_standard_deck();
+    char line[MAX_BATCH_LINE_LENGTH];
+    for (uint32_t i = client->first_request; i < client->end_request; ++i) {
+        draw_random_cards(&deck, NUM_HOLE_CARDS_PER_PLAYER + 3, &client->random_number_generator);
+        fprintf(requests, "id=%u hole=", i);
+        for (uint8_t j = 0; j < NUM_HOLE_CARDS_PER_PLAYER + 3; ++j) {
+            fprintf(requests, "%s%s%c", j == NUM_HOLE_CARDS_PER_PLAYER ? " board=" : "", card_rank_to_human_readable[deck.cards[j].rank], "cdhs"[deck.cards[j].suit]);
+        }
+        fprintf(requests, " players=%d", client->num_players);
+        if (stopping_rule_option.max_num_seconds > 0) {
+            fprintf(requests, " deadline_ms=%.3f", stopping_rule_option.max_num_seconds * 1000);
+        }
+        fprintf(requests, "\n");
+
+        double start = get_time_in_seconds();
+        fflush(requests);
+        if (fgets(line, sizeof(line), responses) == NULL) {
+            client->num_errors += client->end_request - i;
+            break;
+        }
+        client->latencies[i] = get_time_in_seconds() - start;
+        ++(client->num_completed_requests);
+        if (strstr(line, "\"error\"") != NULL) {
+            ++(client->num_errors);
+        }
+    }
+    fclose(requests);
+    fclose(responses);
+    return NULL;
+}
+
+int compare_latencies(const void* latency_0, const void* latency_1) {
+    double difference = *(double*) latency_0 - *(double*) latency_1;
+    return difference < 0 ? -1 : (difference > 0 ? 1 : 0);
+}
+
+bool run_load_test(const char* socket_path, uint8_t num_players) {
+    uint32_t num_requests = num_load_test_requests_option;
+    uint16_t num_connections = num_load_test_connections_option;
+    double* latencies = calloc(num_requests, sizeof(double));
+    LoadTestClient* clients = malloc(num_connections * sizeof(LoadTestClient));
+    pthread_t* threads = malloc(num_connections * sizeof(pthread_t));
+    uint64_t seed = get_random_seed(&main_random_number_generator);
+
+    double start = get_time_in_seconds();
+    uint16_t i;
+    for (i = 0; i < num_connections; ++i) {
+        clients[i].socket_path = socket_path;
+        clients[i].first_request = (uint64_t) num_requests * i / num_connections;
+        clients[i].end_request = (uint64_t) num_requests * (i + 1) / num_connections;
+        clients[i].num_players = num_players;
+        clients[i].latencies = latencies;
+        clients[i].random_number_generator = init_random_number_generator(random_number_generator_algorithm, seed, i);
+        clients[i].num_completed_requests = 0;
+        clients[i].num_errors = 0;
+        pthread_create(&threads[i], NULL, run_load_test_client, &clients[i]);
+    }
+    uint32_t num_errors = 0;
+    for (i = 0; i < num_connections; ++i) {
+        pthread_join(threads[i], NULL);
+        num_errors += clients[i].num_errors;
+    }
+    double elapsed = get_time_in_seconds() - start;
+
+    // The latencies only cover the requests that got a response, so a failing server doesn't make them look faster
+    uint32_t num_latencies = 0;
+    for (i = 0; i < num_connections; ++i) {
+        memmove(&latencies[num_latencies], &latencies[clients[i].first_request], clients[i].num_completed_requests * sizeof(double));
+        num_latencies += clients[i].num_completed_requests;
+    }
+    printf("%u requests over %d connections in %.3f seconds: %.0f requests/sec, ", num_requests, num_connections, elapsed, num_requests / elapsed);
+    if (num_latencies > 0) {
+        qsort(latencies, num_latencies, sizeof(double), compare_latencies);
+        printf("latency p50 %.3f ms, p99 %.3f ms, max %.3f ms over %u responses, ", latencies[num_latencies / 2] * 1000, latencies[(uint64_t) num_latencies * 99 / 100] * 1000, latencies[num_latencies - 1] * 1000, num_latencies);
+    }
+    printf("%u errors\n", num_errors);
+
+    free(latencies);
+    free(clients);
+    free(threads);
+    return num_errors == 0;
+}
+
+// #############################################
+// Command line
+// #############################################
+
+uint8_t num_players_option = MIN_NUM_PLAYERS;
+const char* mode_argument = NULL;
+const char* community_cards_option = NULL;
+const char* ranges_options[MAX_NUM_PLAYERS - 1];
+uint8_t num_ranges_options = 0;
+
+// Parses the "--name=value" options, leaving the mode (if any) in *mode and its argument (if any) in mode_argument
+bool parse_options(int argc, char* argv[], const char** mode) {
+    *mode = "tool";
+    bool has_mode = false;
+    stopping_rule_option = init_stopping_rule();
+    for (int i = 1; i < argc; ++i) {
+        if (strncmp(argv[i], "--", 2) != 0) {
+            if (has_mode == false) {
+                *mode = argv[i];
+                has_mode = true;
+            }
+            else if (mode_argument == NULL) {
+                mode_argument = argv[i];
+            }
+            else {
+                fprintf(stderr, "Unexpected argument: %s\n", argv[i]);
+                return false;
+            }
+        }
+        else if (strncmp(argv[i], "--cache-capacity=", 17) == 0) {
+            result_cache_capacity = strtoul(argv[i] + 17, NULL, 10);
+        }
+        else if (strncmp(argv[i], "--preflop-database=", 19) == 0) {
+            preflop_equity_database_path = argv[i] + 19;
+        }
+        else if (strcmp(argv[i], "--evaluator=brute-force") == 0) {
+            hand_evaluator = BRUTE_FORCE_EVALUATOR;
+        }
+        else if (strcmp(argv[i], "--evaluator=lookup-tables") == 0) {
+            hand_evaluator = LOOKUP_TABLE_EVALUATOR;
+        }
+        else if (strcmp(argv[i], "--rng=xoshiro256**") == 0) {
+            random_number_generator_algorithm = XOSHIRO256_STAR_STAR;
+        }
+        else if (strcmp(argv[i], "--rng=pcg32") == 0) {
+            random_number_generator_algorithm = PCG32;
+        }
+        else if (strcmp(argv[i], "--rng=rand_r") == 0) {
+            random_number_generator_algorithm = RAND_R;
+        }
+        else if (strcmp(argv[i], "--rng=splitmix64") == 0) {
+            random_number_generator_algorithm = SPLITMIX64;
+        }
+        else if (strncmp(argv[i], "--seed=", 7) == 0) {
+            is_seeded = true;
+            seed_option = strtoull(argv[i] + 7, NULL, 10);
+        }
+        else if (strncmp(argv[i], "--shard=", 8) == 0) {
+            if (sscanf(argv[i] + 8, "%u/%u", &shard_index, &num_shards) != 2 || num_shards == 0 || shard_index >= num_shards) {
+                fprintf(stderr, "Expected --shard=k/n, with shards k from 0 to n - 1\n");
+                return false;
+            }
+        }
+        else if (strncmp(argv[i], "--partial-results=", 18) == 0) {
+            partial_results_path_option = argv[i] + 18;
+        }
+        else if (strncmp(argv[i], "--deals=", 8) == 0) {
+            num_deals_option = strtoull(argv[i] + 8, NULL, 10);
+        }
+        else if (strncmp(argv[i], "--deal-equity-trials=", 21) == 0) {
+            unsigned long num_trials = strtoul(argv[i] + 21, NULL, 10);
+            if (num_trials == 0 || num_trials > UINT16_MAX) {
+                fprintf(stderr, "Expected --deal-equity-trials from 1 to %d\n", UINT16_MAX);
+                return false;
+            }
+            num_deal_equity_trials_option = num_trials;
+        }
+        else if (strcmp(argv[i], "--compression=none") == 0) {
+            deals_compression_option = NO_COMPRESSION;
+        }
+        else if (strcmp(argv[i], "--compression=zlib") == 0) {
+            deals_compression_option = ZLIB_COMPRESSION;
+        }
+        else if (strcmp(argv[i], "--method=auto") == 0) {
+            simulation_method = AUTOMATIC_METHOD;
+        }
+        else if (strcmp(argv[i], "--method=exact") == 0) {
+            simulation_method = EXACT_ENUMERATION;
+        }
+        else if (strcmp(argv[i], "--method=monte-carlo") == 0) {
+            simulation_method = MONTE_CARLO;
+        }
+        else if (strcmp(argv[i], "--sampling=plain") == 0) {
+            requested_sampling_method = PLAIN_SAMPLING;
+        }
+        else if (strcmp(argv[i], "--sampling=stratified") == 0) {
+            requested_sampling_method = STRATIFIED_SAMPLING;
+        }
+        else if (strcmp(argv[i], "--sampling=antithetic") == 0) {
+            requested_sampling_method = ANTITHETIC_SAMPLING;
+        }
+        else if (strncmp(argv[i], "--target-standard-error=", 24) == 0) {
+            stopping_rule_option.target_standard_error = atof(argv[i] + 24);
+        }
+        else if (strncmp(argv[i], "--target-confidence-interval-width=", 35) == 0) {
+            // width of the 95% confidence interval, which spans 1.96 standard errors each way
+            stopping_rule_option.target_standard_error = atof(argv[i] + 35) / (2 * 1.96);
+        }
+        else if (strncmp(argv[i], "--max-trials=", 13) == 0) {
+            stopping_rule_option.max_num_trials = strtoull(argv[i] + 13, NULL, 10);
+            if (stopping_rule_option.max_num_trials == 0) {
+                fprintf(stderr, "The maximum number of trials must be positive\n");
+                return false;
+            }
+        }
+        else if (strncmp(argv[i], "--time-budget-ms=", 17) == 0) {
+            stopping_rule_option.max_num_seconds = atof(argv[i] + 17) / 1000;
+        }
+        else if (strcmp(argv[i], "--batch-kernel=scalar") == 0) {
+            requested_batch_hand_evaluation_kernel = SCALAR_KERNEL;
+        }
+        else if (strcmp(argv[i], "--batch-kernel=avx2") == 0) {
+            requested_batch_hand_evaluation_kernel = AVX2_KERNEL;
+        }
+        else if (strcmp(argv[i], "--batch-kernel=avx512") == 0) {
+            requested_batch_hand_evaluation_kernel = AVX512_KERNEL;
+        }
+        else if (strncmp(argv[i], "--threads=", 10) == 0) {
+            int requested_num_threads = atoi(argv[i] + 10);
+            if (requested_num_threads < 1 || requested_num_threads > MAX_NUM_THREADS) {
+                fprintf(stderr, "The number of threads must be between 1 and %d\n", MAX_NUM_THREADS);
+                return false;
+            }
+            num_threads = requested_num_threads;
+        }
+        else if (strncmp(argv[i], "--players=", 10) == 0) {
+            int num_players = atoi(argv[i] + 10);
+            if (num_players < MIN_NUM_PLAYERS || num_players > MAX_NUM_PLAYERS) {
+                fprintf(stderr, "The number of players must be between %d and %d\n", MIN_NUM_PLAYERS, MAX_NUM_PLAYERS);
+                return false;
+            }
+            num_players_option = num_players;
+        }
+        else if (strncmp(argv[i], "--connections=", 14) == 0) {
+            int num_connections = atoi(argv[i] + 14);
+            if (num_connections < 1 || num_connections > MAX_NUM_THREADS) {
+                fprintf(stderr, "The number of connections must be between 1 and %d\n", MAX_NUM_THREADS);
+                return false;
+            }
+            num_load_test_connections_option = num_connections;
+        }
+        else if (strncmp(argv[i], "--requests=", 11) == 0) {
+            if (atol(argv[i] + 11) < 1) {
+                fprintf(stderr, "The number of requests must be positive\n");
+                return false;
+            }
+            num_load_test_requests_option = atol(argv[i] + 11);
+        }
+        else if (strcmp(argv[i], "--format=csv") == 0) {
+            benchmark_format_option = CSV_FORMAT;
+        }
+        else if (strcmp(argv[i], "--format=json") == 0) {
+            benchmark_format_option = JSON_FORMAT;
+        }
+        else if (strncmp(argv[i], "--baseline=", 11) == 0) {
+            benchmark_baseline_option = argv[i] + 11;
+        }
+        else if (strncmp(argv[i], "--regression-threshold=", 23) == 0) {
+            regression_threshold_option = atof(argv[i] + 23);
+            if (regression_threshold_option <= 0) {
+                fprintf(stderr, "The regression threshold must be a positive fraction of the baseline's time, e.g. 0.1 for 10%%\n");
+                return false;
+            }
+        }
+        else if (strcmp(argv[i], "--profile=text") == 0 || strcmp(argv[i], "--profile=json") == 0) {
+#ifdef PROFILE
+            profile_report_option = strcmp(argv[i], "--profile=json") == 0 ? JSON_PROFILE_REPORT : TEXT_PROFILE_REPORT;
+#else
+            fprintf(stderr, "Profiling needs a build with -DPROFILE\n");
+            return false;
+#endif
+        }
+        else if (strncmp(argv[i], "--board=", 8) == 0) {
+            community_cards_option = argv[i] + 8;
+        }
+        else if (strncmp(argv[i], "--range=", 8) == 0) {
+            if (num_ranges_options == MAX_NUM_PLAYERS - 1) {
+                fprintf(stderr, "At most %d opponents can have a range\n", MAX_NUM_PLAYERS - 1);
+                return false;
+            }
+            ranges_options[num_ranges_options++] = argv[i] + 8;
+        }
+        else {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            return false;
+        }
+    }
+    if (num_shards > 1 && (is_seeded == false || stopping_rule_option.target_standard_error > 0 || stopping_rule_option.max_num_seconds > 0)) {
+        fprintf(stderr, "Shards need a --seed and a fixed number of trials, without a target standard error or a time budget\n");
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+
+    long num_online_processors = sysconf(_SC_NPROCESSORS_ONLN);
+    num_threads = num_online_processors > MAX_NUM_THREADS ? MAX_NUM_THREADS : (num_online_processors < 1 ? 1 : num_online_processors);
+
+    const char* mode;
+    if (parse_options(argc, argv, &mode) == false) {
+        return 1;
+    }
+
+    init();
+    init_preflop_equity_database();
+    init_result_cache();
+#ifdef PROFILE
+    init_profile();
+    if (profile_report_option != NO_PROFILE_REPORT) {
+        atexit(print_profile_report_at_exit);
+    }
+#endif
+
+    if (strcmp(mode, "tool") == 0) {
+        tool();
+    }
+    else if (strcmp(mode, "simulate") == 0) {
+        simulate_game(num_players_option);
+    }
+    else if (strcmp(mode, "compare-evaluators") == 0) {
+        compare_evaluators(num_players_option);
+    }
+    else if (strcmp(mode, "scaling-benchmark") == 0) {
+        run_scaling_benchmark(num_players_option);
+    }
+    else if (strcmp(mode, "dealing-benchmark") == 0) {
+        run_dealing_benchmark();
+    }
+    else if (strcmp(mode, "trial-state-benchmark") == 0) {
+        run_trial_state_benchmark();
+    }
+    else if (strcmp(mode, "variance-reduction-benchmark") == 0) {
+        return run_variance_reduction_benchmark() == true ? 0 : 1;
+    }
+    else if (strcmp(mode, "batch-evaluator-benchmark") == 0) {
+        return run_batch_evaluator_benchmark() == true ? 0 : 1;
+    }
+    else if (strcmp(mode, "cache-benchmark") == 0) {
+        run_cache_benchmark(num_players_option);
+    }
+    else if (strcmp(mode, "generate-deals") == 0 && mode_argument != NULL) {
+        return generate_deals(mode_argument, num_players_option) == true ? 0 : 1;
+    }
+    else if (strcmp(mode, "scan-deals") == 0 && mode_argument != NULL) {
+        return scan_deals(mode_argument) == true ? 0 : 1;
+    }
+    else if (strcmp(mode, "generate-preflop-database") == 0) {
+        return generate_preflop_equity_database() == true ? 0 : 1;
+    }
+    else if (strcmp(mode, "preflop-equity") == 0 && mode_argument != NULL) {
+        display_preflop_equity(mode_argument, num_players_option);
+    }
+    else if (strcmp(mode, "validate-evaluators") == 0) {
+        return validate_evaluators() == true ? 0 : 1;
+    }
+    else if (strcmp(mode, "benchmark") == 0) {
+        return run_benchmark_suite() == true ? 0 : 1;
+    }
+    else if (strcmp(mode, "serve") == 0) {
+        return serve(mode_argument != NULL ? mode_argument : DEFAULT_SOCKET_PATH) == true ? 0 : 1;
+    }
+    else if (strcmp(mode, "load-test") == 0) {
+        return run_load_test(mode_argument != NULL ? mode_argument : DEFAULT_SOCKET_PATH, num_players_option) == true ? 0 : 1;
+    }
+    else if (strcmp(mode, "batch") == 0) {
+        return run_batch(mode_argument) == true ? 0 : 1;
+    }
+    else if (strcmp(mode, "merge-results") == 0 && mode_argument != NULL) {
+        return merge_partial_results(mode_argument) == true ? 0 : 1;
+    }
+    else if (strcmp(mode, "compare-hands") == 0 && mode_argument != NULL) {
+        return display_hero_comparison(mode_argument, community_cards_option, num_players_option) == true ? 0 : 1;
+    }
+    else if (strcmp(mode, "equity-curve") == 0 && mode_argument != NULL) {
+        return display_equity_curve(mode_argument, community_cards_option, ranges_options, num_ranges_options) == true ? 0 : 1;
+    }
+    else if (strcmp(mode, "outs") == 0 && mode_argument != NULL) {
+        return display_outs(mode_argument, community_cards_option, ranges_options, num_ranges_options, num_players_option) == true ? 0 : 1;
+    }
+    else if (strcmp(mode, "range-equity") == 0 && mode_argument != NULL) {
+        return display_range_equity(mode_argument, community_cards_option, ranges_options, num_ranges_options, num_players_option) == true ? 0 : 1;
+    }
+    else {
+        fprintf(stderr, "Unknown mode: %s\n", mode);
+        return 1;
+    }
 
     return 0;
 }